@@ -1,11 +1,42 @@
 #include "GL.h"
 
 #include <vector>
-#include <glm\vec2.hpp>
-#include <glm\vec3.hpp>
-#include <glm\vec4.hpp>
-#include <glm\mat4x4.hpp>
-#include <glm\gtc\matrix_transform.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <cfloat>
+#include <string>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GL_SSE
+#include <emmintrin.h>
+#endif
 
 #define GL_BEGIN_CHECK if (context->beginMode != -1) { context->err = GL_INVALID_OPERATION; return; }
 #define GL_CLAMP(val) (val < 0.0f ? 0.0f : (val > 1.0f ? 1.0f : val))
@@ -55,19 +86,225 @@ struct Pixel {
 	}
 };
 
+#pragma region Object Pools
+/*
+Power of two size class allocator for texel storage.
+
+Blocks are carved out of large chunks and recycled through per class freelists, so
+churning textures never goes back to the heap and never fragments it. Requests above
+the largest class fall back to the heap.
+*/
+struct TexelPool {
+	static const int MIN_CLASS_SHIFT = 6;			// 64 bytes
+	static const int NUM_CLASSES = 20;				// up to 32MB
+	static const size_t CHUNK_SIZE = 1 << 20;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	FreeBlock* freeLists[NUM_CLASSES];
+	std::vector<void*> chunks;
+	char* chunkCur;
+	size_t chunkLeft;
+
+	TexelPool()
+		:	chunkCur(nullptr),
+			chunkLeft(0)
+	{
+		for (int i = 0; i < NUM_CLASSES; i++) {
+			freeLists[i] = nullptr;
+		}
+	}
+
+	~TexelPool() {
+		for (size_t i = 0; i < chunks.size(); i++) {
+			free(chunks[i]);
+		}
+	}
+
+	static size_t classSize(int sizeClass) {
+		return (size_t)1 << (sizeClass + MIN_CLASS_SHIFT);
+	}
+
+	static int classOf(size_t bytes) {
+		int sizeClass = 0;
+		while (sizeClass < NUM_CLASSES && classSize(sizeClass) < bytes) {
+			sizeClass++;
+		}
+		return sizeClass < NUM_CLASSES ? sizeClass : -1;
+	}
+
+	void* alloc(size_t bytes, int& sizeClass) {
+		sizeClass = classOf(bytes);
+		if (sizeClass == -1) {
+			return malloc(bytes);
+		}
+
+		if (freeLists[sizeClass] != nullptr) {
+			FreeBlock* block = freeLists[sizeClass];
+			freeLists[sizeClass] = block->next;
+			return block;
+		}
+
+		size_t size = classSize(sizeClass);
+		if (size >= CHUNK_SIZE) {
+			void* block = malloc(size);
+			chunks.push_back(block);
+			return block;
+		}
+
+		if (chunkLeft < size) {
+			// hand the tail of the old chunk to the smaller classes before starting a new one
+			while (chunkLeft >= classSize(0)) {
+				int tailClass = classOf(chunkLeft);
+				if (tailClass == -1 || classSize(tailClass) > chunkLeft) tailClass--;
+				release(chunkCur, tailClass);
+				chunkCur += classSize(tailClass);
+				chunkLeft -= classSize(tailClass);
+			}
+
+			chunkCur = (char*)malloc(CHUNK_SIZE);
+			chunkLeft = CHUNK_SIZE;
+			chunks.push_back(chunkCur);
+		}
+
+		void* block = chunkCur;
+		chunkCur += size;
+		chunkLeft -= size;
+		return block;
+	}
+
+	void release(void* block, int sizeClass) {
+		if (sizeClass == -1) {
+			free(block);
+			return;
+		}
+
+		FreeBlock* freeBlock = (FreeBlock*)block;
+		freeBlock->next = freeLists[sizeClass];
+		freeLists[sizeClass] = freeBlock;
+	}
+};
+
+/*
+Slot map addressed by generation checked handles.
+
+A handle packs the slot index (plus one, so 0 is never a valid name) in the low bits and
+the slot generation above it. Destroying an object bumps the generation, so stale handles
+are rejected instead of aliasing whatever reuses the slot. Create and destroy are O(1).
+*/
+template<typename T>
+struct ObjectPool {
+	static const int INDEX_BITS = 20;
+	static const int INDEX_MASK = (1 << INDEX_BITS) - 1;
+	static const int GENERATION_MASK = 0x7FF;
+
+	struct Slot {
+		T object;
+		int generation;
+		int nextFree;
+		bool alive;
+	};
+
+	std::vector<Slot> slots;
+	int freeHead;
+
+	ObjectPool()
+		: freeHead(-1)
+	{
+
+	}
+
+	int create() {
+		int index;
+		if (freeHead != -1) {
+			index = freeHead;
+			freeHead = slots[index].nextFree;
+		}
+		else {
+			if ((int)slots.size() >= INDEX_MASK) {
+				return 0;
+			}
+			index = (int)slots.size();
+			slots.push_back(Slot());
+			slots[index].generation = 0;
+		}
+
+		Slot& slot = slots[index];
+		slot.object = T();
+		slot.nextFree = -1;
+		slot.alive = true;
+		return (slot.generation << INDEX_BITS) | (index + 1);
+	}
+
+	T* get(int handle) {
+		int index = (handle & INDEX_MASK) - 1;
+		if (index < 0 || index >= (int)slots.size()) return nullptr;
+
+		Slot& slot = slots[index];
+		if (!slot.alive || slot.generation != ((handle >> INDEX_BITS) & GENERATION_MASK)) return nullptr;
+		return &slot.object;
+	}
+
+	bool destroy(int handle) {
+		if (get(handle) == nullptr) return false;
+
+		int index = (handle & INDEX_MASK) - 1;
+		Slot& slot = slots[index];
+		slot.alive = false;
+		slot.generation = (slot.generation + 1) & GENERATION_MASK;
+		slot.nextFree = freeHead;
+		freeHead = index;
+		return true;
+	}
+};
+#pragma endregion
+
+// refs counts the name and every context the texture is bound in, see ShareGroup
 struct Texture {
 	int w, h;
-	Pixel* pixels;
-
-	Texture() 
-		: w(0), h(0), pixels(nullptr)
+	int format;
+	void* texels;
+	int sizeClass;
+
+	// Color table for the paletted formats, always 256 entries once specified
+	Pixel* palette;
+	int paletteClass;
+
+	int refs;
+
+	Texture()
+		:	w(0), h(0),
+			format(GL_RGBA),
+			texels(nullptr),
+			sizeClass(-1),
+			palette(nullptr),
+			paletteClass(-1),
+			refs(1)
 	{
 
 	}
+};
+
+/*
+Direct mapped cache of decoded DXT1 blocks, keyed by the address of the compressed block.
+Neighbouring fragments mostly hit the same 4x4 block, so each block is decoded once
+instead of once per fragment.
+*/
+struct BlockCache {
+	static const int SIZE = 32;
+
+	const unsigned char* keys[SIZE];
+	Pixel texels[SIZE][16];
+
+	BlockCache() {
+		invalidate();
+	}
 
-	~Texture() {
-		if (pixels != nullptr) {
-			delete pixels;
+	void invalidate() {
+		for (int i = 0; i < SIZE; i++) {
+			keys[i] = nullptr;
 		}
 	}
 };
@@ -87,820 +324,4686 @@ struct Vertex {
 	}
 };
 
-struct GLContext {
-	int w, h;
-
-	Pixel* bufColor;
-	float* bufDepth;
+#pragma region Framebuffer Formats
+/*
+Storage traits of the framebuffer formats. The raster and readback kernels are instantiated
+per format pair, so the per fragment encode and decode compiles down to the packed format
+instead of going through a switch.
+*/
+unsigned int toUnorm8(float v) {
+	return (unsigned int)(GL_CLAMP(v) * 255.0f + 0.5f);
+}
 
-	glm::mat4 matModelView;
-	glm::mat4 matProj;
-	glm::mat4* curMatrix;
+struct ColorRGBA32F {
+	typedef Pixel Storage;
 
-	int err;
+	static Storage encode(const Pixel& p) { return p; }
+	static Pixel decode(const Storage& s) { return s; }
+};
 
-	Pixel bufColorClear;
-	float bufDepthClear;
+// r, g, b, a bytes in memory order, the same layout as a GL_RGBA / GL_BYTE readback
+struct ColorRGBA8 {
+	typedef unsigned int Storage;
 
-	int beginMode;
-	Pixel beginColor;
-	glm::vec2 beginTexCoord;
+	static Storage encode(const Pixel& p) {
+		return toUnorm8(p.r) | (toUnorm8(p.g) << 8) | (toUnorm8(p.b) << 16) | (toUnorm8(p.a) << 24);
+	}
 
-	std::vector<Texture> textures;
-	int curTexture;
+	static Pixel decode(Storage s) {
+		return Pixel((unsigned char)s, (unsigned char)(s >> 8), (unsigned char)(s >> 16), (unsigned char)(s >> 24));
+	}
+};
 
-	bool depthEnabled;
-	bool cullingEnabled;
-	bool textureEnabled;
-	bool extOlcSlowColor;
+struct ColorRGB565 {
+	typedef unsigned short Storage;
 
-	std::vector<Vertex> beginVertices;
-	
-	GLContext(int w, int h) 
-		:	w(w),
-			h(h),
-			bufColor(new Pixel[w * h]),
-			bufDepth(new float[w * h]),
-			matModelView(glm::mat4(1.0f)),
-			matProj(glm::mat4(1.0f)),
-			curMatrix(&matModelView),
-			err(GL_NO_ERROR),
-			bufColorClear(Pixel(0.0f, 0.0f, 0.0f, 1.0f)),
-			bufDepthClear(-1.0f),
-			beginMode(-1),
-			beginColor(Pixel(1.0f, 1.0f, 1.0f, 1.0f)),
-			beginTexCoord(glm::vec2(0.0f, 0.0f)),
-			curTexture(0),
-			depthEnabled(false),
-			cullingEnabled(false),
-			textureEnabled(false),
-			extOlcSlowColor(false)
-	{
-		for (int i = 0; i < w * h; i++) {
-			bufColor[i] = bufColorClear;
-		}
+	static Storage encode(const Pixel& p) {
+		return (Storage)(((unsigned int)(GL_CLAMP(p.r) * 31.0f + 0.5f) << 11) | ((unsigned int)(GL_CLAMP(p.g) * 63.0f + 0.5f) << 5) | (unsigned int)(GL_CLAMP(p.b) * 31.0f + 0.5f));
 	}
 
-	~GLContext() {
-		delete bufColor;
-		delete bufDepth;
+	static Pixel decode(Storage s) {
+		return Pixel(((s >> 11) & 0x1F) / 31.0f, ((s >> 5) & 0x3F) / 63.0f, (s & 0x1F) / 31.0f, 1.0f);
 	}
+};
+
+/*
+Console cells, an index into olcCells (see the OLC region). Fragments are classified as they are
+written, so EXT_OLC_PIXEL_FORMAT readback is a table lookup and there is no float color buffer.
+Decoding gives the color the cell shows, used for blending and RGBA readback.
+*/
+struct ColorOlcCell {
+	typedef unsigned char Storage;
 
+	static Storage encode(const Pixel& p);
+	static Pixel decode(Storage s);
 };
 
-thread_local GLContext* context;
+/*
+Depth is kept in normalized device coordinates, [-1, 1]. The unorm formats map that range
+onto their integer range, so depth compares are integer compares.
+*/
+struct DepthF32 {
+	typedef float Storage;
 
-void glInit(int w, int h)
-{
-	context = new GLContext(w, h);
-}
+	static Storage encode(float z) { return z; }
+	static float decode(Storage d) { return d; }
+};
 
-const char* glGetString(int string) {
-	switch (string) {
-		case GL_VENDOR: return "Itay Almog";
-		case GL_RENDERER: return "Software Based (C++)";
-		case GL_VERSION: return "OpenGL 1.1 WIN32";
-		case GL_EXTENSIONS: return "EXT_OLC";
-	default:
-		context->err = GL_INVALID_ENUM;
-		return nullptr;
-	}
-}
+struct DepthU16 {
+	typedef unsigned short Storage;
 
-void glEnable(int capability) {
-	GL_BEGIN_CHECK;
+	static Storage encode(float z) { return (Storage)(GL_CLAMP(z * 0.5f + 0.5f) * 65535.0f + 0.5f); }
+	static float decode(Storage d) { return d * (2.0f / 65535.0f) - 1.0f; }
+};
 
-	switch (capability) {
-	case GL_DEPTH_TEST: context->depthEnabled = true; break;
-	case GL_CULL_FACE: context->cullingEnabled = true; break;
-	case GL_TEXTURE_2D: context->textureEnabled = true; break;
-	default:
-		context->err = GL_INVALID_ENUM;
+struct DepthU24 {
+	typedef unsigned int Storage;
+
+	static Storage encode(float z) { return (Storage)((double)GL_CLAMP(z * 0.5f + 0.5f) * 16777215.0 + 0.5); }
+	static float decode(Storage d) { return (float)(d * (2.0 / 16777215.0) - 1.0); }
+};
+
+size_t colorFormatSize(int format) {
+	switch (format) {
+	case GL_RGBA8: return sizeof(ColorRGBA8::Storage);
+	case GL_RGB565: return sizeof(ColorRGB565::Storage);
+	case EXT_OLC_PIXEL_FORMAT: return sizeof(ColorOlcCell::Storage);
+	default: return sizeof(ColorRGBA32F::Storage);
 	}
 }
 
-void glDisable(int capability) {
-	GL_BEGIN_CHECK;
-
-	switch (capability) {
-	case GL_DEPTH_TEST: context->depthEnabled = false; break;
-	case GL_CULL_FACE: context->cullingEnabled = false; break;
-	case GL_TEXTURE_2D: context->textureEnabled = false; break;
-	default:
-		context->err = GL_INVALID_ENUM;
+size_t depthFormatSize(int format) {
+	switch (format) {
+	case GL_DEPTH_COMPONENT16: return sizeof(DepthU16::Storage);
+	case GL_DEPTH_COMPONENT24: return sizeof(DepthU24::Storage);
+	default: return sizeof(DepthF32::Storage);
 	}
 }
 
-int glGetError() {
-	if (context->beginMode != -1) return GL_NO_ERROR;
-	return context->err;
+void* alignedAlloc(size_t size) {
+#ifdef _WIN32
+	return _aligned_malloc(size, 64);
+#else
+	void* block;
+	return posix_memalign(&block, 64, size) == 0 ? block : nullptr;
+#endif
 }
 
-void glClearColor(float r, float g, float b, float a) {
-	GL_BEGIN_CHECK;
-	
-	context->bufColorClear = Pixel(r, g, b, a);
+void alignedFree(void* block) {
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
 }
 
-void glClearDepth(float depth) {
-	GL_BEGIN_CHECK;
+/*
+The framebuffer is split into square tiles. glClear only flags the tiles and records the clear
+values, a tile is filled when a primitive first touches it and readback of a tile nobody drew
+to converts the clear value directly.
+*/
+#define GL_TILE_SHIFT			(4)
+#define GL_TILE_SIZE			(1 << GL_TILE_SHIFT)
+#define GL_TILE_COLOR_CLEAR		(0x01)
+#define GL_TILE_DEPTH_CLEAR		(0x02)
+// Color written since the last dirty tile cell readback, see EXT_OLC_DIRTY_TILES
+#define GL_TILE_DIRTY			(0x04)
+// Color written since the last glWriteFrameEXT, which hands it to the dirty tiles of every callback sink
+#define GL_TILE_SINK_DIRTY		(0x08)
+
+struct RasterKernels {
+	void (*point)(Vertex p);
+	void (*line)(Vertex p1, Vertex p2);
+	void (*triangle)(Vertex p1, Vertex p2, Vertex p3);
+	void (*quad)(Vertex p1, Vertex p2, Vertex p3, Vertex p4);
+};
+#pragma endregion
 
-	context->bufDepthClear = depth;
-}
+/*
+Everything readback looks at, with the clear values already encoded in the buffer formats.
+Readback goes through this instead of the context, so it does not care where the buffers are.
+*/
+struct FramebufferView {
+	int w, h;
+	int colorFormat;
+	int depthFormat;
+	const void* color;
+	const void* depth;
+	const unsigned char* tileFlags;
+	int tilesX;
+	unsigned char colorClear[sizeof(Pixel)];
+	unsigned char depthClear[sizeof(float)];
+	bool slowColor;
+	bool dirtyOnly;
+};
+
+// A rectangle of the framebuffer, clipped to it, and where its first pixel goes in client memory
+struct ReadRegion {
+	int x, y, w, h;
+	unsigned char* data;
+	size_t stride;
+};
+
+void readPixels(const FramebufferView& view, const ReadRegion& region, int format, int type);
+
+struct ReadbackWorker;
+
+/*
+Buffer object, pixel pack buffers are the only target. lastJob is the job of writer that
+writes it last, the storage may not be touched before it completed. refs counts the name
+and every context the buffer is bound in.
+*/
+struct Buffer {
+	unsigned char* data;
+	size_t size;
+	bool mapped;
+	ReadbackWorker* writer;
+	unsigned long long lastJob;
+	int refs;
+
+	Buffer()
+		:	data(nullptr),
+			size(0),
+			mapped(false),
+			writer(nullptr),
+			lastJob(0),
+			refs(1)
+	{
 
-void glClear(int mask) {
-	if (mask - GL_COLOR_BUFFER_BIT - GL_DEPTH_BUFFER_BIT > 0) {
-		context->err = GL_INVALID_VALUE;
-		return;
 	}
+};
 
-	int size = context->w * context->h;
+/*
+Runs glReadPixels into pixel pack buffers on its own thread, the render thread only copies
+the rows being read. Jobs complete in the order they were submitted, so waiting for a job
+means waiting until the completed count reaches it.
+*/
+struct ReadbackWorker {
+	struct Job {
+		std::vector<unsigned char> snapshot;
+		FramebufferView view;
+		ReadRegion region;
+		int format;
+		int type;
+	};
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::deque<Job> jobs;
+	std::vector<std::vector<unsigned char> > spareSnapshots;
+	unsigned long long submitted;
+	unsigned long long completed;
+	bool quit;
+
+	ReadbackWorker()
+		:	submitted(0),
+			completed(0),
+			quit(false)
+	{
 
-	if ((mask & GL_COLOR_BUFFER_BIT) != 0) {
-		for (int i = 0; i < size; i++) {
-			context->bufColor[i] = context->bufColorClear;
-		}
 	}
 
-	if ((mask & GL_DEPTH_BUFFER_BIT) != 0) {
-		for (int i = 0; i < size; i++) {
-			context->bufDepth[i] = context->bufDepthClear;
-		}
+	~ReadbackWorker() {
+		stop();
 	}
-}
 
-void glBegin(int mode) {
-	GL_BEGIN_CHECK;
+	std::vector<unsigned char> takeSnapshot() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (spareSnapshots.empty()) return std::vector<unsigned char>();
 
-	switch (mode) {
-	case GL_POINTS:
-	case GL_LINES:
-	case GL_TRIANGLES:
-	case GL_QUADS:
-		context->beginMode = mode;
-		context->beginVertices.clear();
-		break;
-	default:
-		context->err = GL_INVALID_ENUM;
-		return;
+		std::vector<unsigned char> snapshot;
+		snapshot.swap(spareSnapshots.back());
+		spareSnapshots.pop_back();
+		return snapshot;
 	}
-}
 
-void drawPoint(Vertex p) {
-	int o = (int)(glm::floor(p.coord.x) + glm::floor(p.coord.y) * context->w);
+	unsigned long long submit(Job& job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!thread.joinable()) {
+			quit = false;
+			thread = std::thread(&ReadbackWorker::run, this);
+		}
 
-	if (context->depthEnabled) {
-		float d = p.coord.z;
-		if (d > context->bufDepth[o]) return;
-		else context->bufDepth[o] = d;
+		jobs.push_back(Job());
+		jobs.back().snapshot.swap(job.snapshot);
+		jobs.back().view = job.view;
+		jobs.back().region = job.region;
+		jobs.back().format = job.format;
+		jobs.back().type = job.type;
+		wake.notify_one();
+		return ++submitted;
 	}
 
-	// Vertex Color
-	Pixel fragColor = p.color;
+	void wait(unsigned long long job) {
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return completed >= job; });
+	}
 
-	// Texture samples
-	if (context->textureEnabled && context->curTexture != -1) {
-		const Texture& tex = context->textures[context->curTexture];
-		float u = p.texCoord.x;
-		float v = p.texCoord.y;
-		u = (float)(((int)glm::floor(u * tex.w)) % tex.w);
-		v = (float)(((int)glm::floor(v * tex.h)) % tex.h);
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+			wake.notify_one();
+		}
 
-		int to = (int)(u + v * tex.w);
-		fragColor.r *= tex.pixels[to].r;
-		fragColor.g *= tex.pixels[to].g;
-		fragColor.b *= tex.pixels[to].b;
-		fragColor.a *= tex.pixels[to].a;
+		if (thread.joinable()) thread.join();
 	}
 
-	context->bufColor[o] = fragColor;
-}
-
-void drawLine(Vertex p1, Vertex p2) {
-	int x0 = (int)glm::floor(p1.coord.x);
-	int y0 = (int)glm::floor(p1.coord.y);
-	int x1 = (int)glm::ceil(p2.coord.x);
-	int y1 = (int)glm::ceil(p2.coord.y);
-	int dx = glm::abs(x1 - x0);
-	int dy = glm::abs(y1 - y0);
-	int sx = x0 < x1 ? 1 : -1;
-	int sy = y0 < y1 ? 1 : -1;
-	int err = dx - dy;
+	void run();
+};
 
-	int totDist = dx > dy ? dx : dy;
-	while (true) {
-		float ic0 = glm::abs(dx > dy ? (x1 - x0) : (y1 - y0)) / totDist;
-		float ic1 = 1.0 - ic0;
+/*
+Threads that convert the bands of a synchronous readback, see forEachBand. The calling thread
+takes bands as well and run returns once every band is done. Bands are claimed from next, which
+holds the generation in the high and the next band in the low 32 bits, so a worker that wakes up
+late can not take a band of a later run, it only gets one while its run is still going.
+*/
+struct ConvertPool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int)>* job;
+	int bands;
+	int helpers;
+	std::atomic<unsigned long long> next;
+	int busy;
+	unsigned int generation;
+	bool quit;
+
+	ConvertPool()
+		:	job(nullptr),
+			bands(0),
+			helpers(0),
+			next(0),
+			busy(0),
+			generation(0),
+			quit(false)
+	{
 
-		int o = (x0 + y0 * context->w);
-		float z = 1 / (ic0 * 1 / p1.coord.z + ic1 * 1 / p2.coord.z);
-		if (context->depthEnabled) {
-			if (z > context->bufDepth[o]) continue;
-			else context->bufDepth[o] = z;
-		}
+	}
 
-		// Vertex Color
-		Pixel fragColor;
-		fragColor.r = (ic0*p1.color.r / p1.coord.z + ic1 * p2.color.r / p2.coord.z) * z;
-		fragColor.g = (ic0*p1.color.g / p1.coord.z + ic1 * p2.color.g / p2.coord.z) * z;
-		fragColor.b = (ic0*p1.color.b / p1.coord.z + ic1 * p2.color.b / p2.coord.z) * z;
-		fragColor.a = (ic0*p1.color.a / p1.coord.z + ic1 * p2.color.a / p2.coord.z) * z;
+	~ConvertPool() {
+		stop();
+	}
 
-		// Texture sample
-		if (context->textureEnabled && context->curTexture != -1) {
-			Texture& tex = context->textures[context->curTexture];
-			float u = (ic0*p1.texCoord.x / p1.coord.z + ic1 * p2.texCoord.x / p2.coord.z) * z;
-			float v = (ic0*p1.texCoord.y / p1.coord.z + ic1 * p2.texCoord.y / p2.coord.z) * z;
-			u = (float)((int)glm::floor(u * tex.w) % tex.w); // This behaviour should later depend on GL_TEXTURE_WRAP_S
-			v = (float)((int)glm::floor(v * tex.h) % tex.h);
+	// Run fn for every band on count of the threadCount threads, the caller included
+	void run(int threadCount, int count, int bandCount, const std::function<void(int)>& fn) {
+		if ((int)threads.size() != threadCount - 1) {
+			stop();
+			quit = false;
+			for (int i = 0; i < threadCount - 1; i++) {
+				threads.push_back(std::thread(&ConvertPool::work, this));
+			}
+		}
 
-			int to = (int)(u + v * tex.w);
-			fragColor.r *= tex.pixels[to].r;
-			fragColor.g *= tex.pixels[to].g;
-			fragColor.b *= tex.pixels[to].b;
-			fragColor.a *= tex.pixels[to].a;
+		unsigned int current;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &fn;
+			bands = bandCount;
+			helpers = count - 1;
+			current = ++generation;
+			next = (unsigned long long)current << 32;
 		}
+		wake.notify_all();
 
-		context->bufColor[o] = fragColor;
+		takeBands(current, bandCount, fn);
 
-		if (x0 == x1 && y0 == y1) break;
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return busy == 0; });
+	}
 
-		float e2 = 2 * err;
-		if (e2 > -dy) {
-			err -= dy;
-			x0 += sx;
+	void takeBands(unsigned int gen, int bandCount, const std::function<void(int)>& fn) {
+		unsigned long long claim = next;
+		while ((unsigned int)(claim >> 32) == gen && (int)(claim & 0xFFFFFFFF) < bandCount) {
+			if (next.compare_exchange_weak(claim, claim + 1)) {
+				fn((int)(claim & 0xFFFFFFFF));
+				claim = next;
+			}
 		}
-		if(e2 < dx) {
-			err += dx;
-			y0 += sy;
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+
+		for (size_t i = 0; i < threads.size(); i++) {
+			threads[i].join();
 		}
+		threads.clear();
 	}
-}
 
-void drawTriangle(Vertex p1, Vertex p2, Vertex p3) {
-	if (context->cullingEnabled && !p1.cull) return;
+	void work() {
+		unsigned int seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [&] { return quit || (generation != seen && helpers > 0); });
+			if (quit) return;
+
+			// fn is only called for a band claimed in this generation, while run still waits for it
+			seen = generation;
+			helpers--;
+			busy++;
+			const std::function<void(int)>& fn = *job;
+			int bandCount = bands;
+			lock.unlock();
+			takeBands(seen, bandCount, fn);
+			lock.lock();
+			if (--busy == 0) done.notify_all();
+		}
+	}
+};
 
-	int x1 = (int)glm::floor(p1.coord.x);
-	int x2 = (int)glm::floor(p2.coord.x);
-	int x3 = (int)glm::floor(p3.coord.x);
-	int y1 = (int)glm::floor(p1.coord.y);
-	int y2 = (int)glm::floor(p2.coord.y);
-	int y3 = (int)glm::floor(p3.coord.y);
+// Frames a file sink may be behind before glWriteFrameEXT waits for it
+#define GL_SINK_MAX_FRAMES		(4)
+// Encoded bytes a sink collects before writing them out
+#define GL_SINK_FLUSH_SIZE		(1 << 20)
+
+/*
+Write only file of a frame sink, the sink does its own buffering so every write goes to the OS
+*/
+struct SinkFile {
+#ifdef _WIN32
+	HANDLE file;
+#else
+	int fd;
+#endif
+
+	SinkFile()
+#ifdef _WIN32
+		: file(INVALID_HANDLE_VALUE)
+#else
+		: fd(-1)
+#endif
+	{
 
-	int minX = (int)glm::min(x1, glm::min(x2, x3));
-	int minY = (int)glm::min(y1, glm::min(y2, y3));
-	int maxX = (int)glm::max(x1, glm::max(x2, x3));
-	int maxY = (int)glm::max(y1, glm::max(y2, y3));
+	}
 
-	float factor = 1.0f / ((y2 - y3)*(x1 - x3) + (x3 - x2)*(y1 - y3));
+	~SinkFile() {
+		close();
+	}
 
-	int o = 0;
-	for (int x = minX; x <= maxX; x++) {
-		for (int y = minY; y <= maxY; y++) {
-			float ic0 = ((y2 - y3)*(x - x3) + (x3 - x2)*(y - y3)) * factor;
-			if (ic0 < 0 || ic0 > 1) continue;
-			float ic1 = ((y3 - y1)*(x - x3) + (x1 - x3)*(y - y3)) * factor;
-			if (ic1 < 0 || ic1 > 1) continue;
-			float ic2 = 1.0f - ic0 - ic1;
-			if (ic2 < 0 || ic2 > 1) continue;
+	bool open(const char* path) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		return file != INVALID_HANDLE_VALUE;
+#else
+		fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		return fd != -1;
+#endif
+	}
 
-			o = (x + y * context->w);
-			if (o >= context->w  * context->h || o < 0) {
-				continue;
+	bool write(const void* data, size_t size) {
+		const char* p = (const char*)data;
+		while (size > 0) {
+#ifdef _WIN32
+			DWORD written;
+			DWORD chunk = (DWORD)glm::min(size, (size_t)0x40000000);
+			if (!WriteFile(file, p, chunk, &written, NULL)) return false;
+#else
+			ssize_t written = ::write(fd, p, size);
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				return false;
 			}
+#endif
+			p += written;
+			size -= written;
+		}
+		return true;
+	}
 
-			float z = 1 / (ic0 * 1 / p1.coord.z + ic1 * 1 / p2.coord.z + ic2 * 1 / p3.coord.z);
-			if (context->depthEnabled) {
-				if (z > context->bufDepth[o]) continue;
-				else context->bufDepth[o] = z;
-			}
+	bool close() {
+#ifdef _WIN32
+		if (file == INVALID_HANDLE_VALUE) return true;
+		bool ok = CloseHandle(file) != 0;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (fd == -1) return true;
+		bool ok = ::close(fd) == 0;
+		fd = -1;
+#endif
+		return ok;
+	}
+};
 
-			// Vertex color
+/*
+Encodes frames on its own thread, glWriteFrameEXT only snapshots the color buffer. The encoded
+bytes are collected in out and written once GL_SINK_FLUSH_SIZE is reached or the queue ran dry.
+*/
+struct FrameSink {
+	struct Job {
+		std::vector<unsigned char> snapshot;
+		FramebufferView view;
+		int scaleW, scaleH;
+		int scaleFilter;
+	};
+
+	int type;
+	int w, h;
+	int fps;
+	std::string path;
+	SinkFile file;
+	std::atomic<bool> failed;
+	int maxFrames;
+
+	// EXT_FRAME_SINK_CALLBACK
+	int format;
+	int readType;
+	OlcFrameCallbackEXT callback;
+	void* user;
+	int scaleW, scaleH;
+	int scaleFilter;
+
+	// Tiles drawn to since this callback sink was last written, only touched by the thread running glWriteFrameEXT
+	std::vector<unsigned char> dirtyTiles;
+
+	// Only touched by the sink thread
+	unsigned long long frames;
+	int frameW, frameH;
+	std::vector<unsigned char> pixels;
+	std::vector<OlcPixel> cells;
+	std::vector<OlcPixel> prevCells;
+	int pen;
+	std::string out;
+	std::vector<unsigned char> scaleSource;
+	std::vector<unsigned char> scaled;
+	std::vector<unsigned char> scaledTiles;
+	std::vector<int> rects;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::deque<Job> jobs;
+	std::vector<std::vector<unsigned char> > spareSnapshots;
+	bool quit;
+
+	FrameSink(int type, int w, int h, int fps)
+		:	type(type),
+			w(w),
+			h(h),
+			fps(fps),
+			failed(false),
+			maxFrames(GL_SINK_MAX_FRAMES),
+			format(GL_RGBA),
+			readType(GL_BYTE),
+			callback(nullptr),
+			user(nullptr),
+			scaleW(0),
+			scaleH(0),
+			scaleFilter(GL_NEAREST),
+			frames(0),
+			frameW(0),
+			frameH(0),
+			pen(-1),
+			quit(false)
+	{
+
+	}
+
+	~FrameSink() {
+		stop();
+	}
+
+	std::vector<unsigned char> takeSnapshot() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (spareSnapshots.empty()) return std::vector<unsigned char>();
+
+		std::vector<unsigned char> snapshot;
+		snapshot.swap(spareSnapshots.back());
+		spareSnapshots.pop_back();
+		return snapshot;
+	}
+
+	void submit(Job& job) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!thread.joinable()) {
+			thread = std::thread(&FrameSink::run, this);
+		}
+
+		done.wait(lock, [&] { return jobs.size() < (size_t)maxFrames; });
+		jobs.push_back(Job());
+		jobs.back().snapshot.swap(job.snapshot);
+		jobs.back().view = job.view;
+		jobs.back().scaleW = scaleW;
+		jobs.back().scaleH = scaleH;
+		jobs.back().scaleFilter = scaleFilter;
+		wake.notify_one();
+	}
+
+	// Write what is queued and close the file
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+			wake.notify_one();
+		}
+
+		if (thread.joinable()) thread.join();
+		if (!file.close()) failed = true;
+	}
+
+	void run();
+	FramebufferView scale(const Job& job);
+	void encode(const FramebufferView& view);
+	void encodeY4M();
+	void encodeAsciicast();
+	void flush();
+};
+
+/*
+Textures and pixel pack buffers, shared by every context created with the group. Names and binds
+hold references, so an object deleted while another context still has it bound lives on until that
+context lets go of it. The tables, reference counts and texel pool are guarded by mutex, drawing
+takes no lock. Texel contents are not guarded: any number of contexts may sample a texture, but
+respecifying it while another context draws with it is undefined, as in GL.
+
+Readback workers outlive their context so buffers can always wait on their writer, the worker of a
+destroyed context is handed to the next context created in the group.
+*/
+struct ShareGroup {
+	std::mutex mutex;
+	int contexts;
+
+	TexelPool texelPool;
+	ObjectPool<Texture*> textures;
+	ObjectPool<Buffer*> buffers;
+
+	// Bumped whenever texels are released, the block caches of the contexts compare against it
+	std::atomic<unsigned int> texelGeneration;
+
+	std::deque<ReadbackWorker> readbackWorkers;
+	std::vector<ReadbackWorker*> idleWorkers;
+
+	ShareGroup()
+		:	contexts(0),
+			texelGeneration(0)
+	{
+
+	}
+
+	~ShareGroup();
+
+	ReadbackWorker* takeWorker() {
+		if (idleWorkers.empty()) {
+			readbackWorkers.emplace_back();
+			return &readbackWorkers.back();
+		}
+
+		ReadbackWorker* worker = idleWorkers.back();
+		idleWorkers.pop_back();
+		return worker;
+	}
+};
+
+#pragma region Command Ring
+// Commands the ring holds, a power of two
+#define GL_RING_SIZE			(1 << 14)
+// Times the render thread looks for more commands before it goes to sleep
+#define GL_RING_SPIN			(64)
+
+enum CommandOp {
+	CMD_ENABLE,
+	CMD_DISABLE,
+	CMD_CLEAR_COLOR,
+	CMD_CLEAR_DEPTH,
+	CMD_CLEAR,
+	CMD_ALPHA_FUNC,
+	CMD_BLEND_FUNC,
+	CMD_BEGIN,
+	CMD_END,
+	CMD_COLOR,
+	CMD_TEX_COORD,
+	CMD_VERTEX,
+	CMD_MATRIX_MODE,
+	CMD_LOAD_IDENTITY,
+	CMD_TRANSLATE,
+	CMD_SCALE,
+	CMD_ROTATE,
+	CMD_PERSPECTIVE,
+	// Followed by two CMD_ARGS slots
+	CMD_LOOK_AT,
+	CMD_ARGS,
+	CMD_BIND_TEXTURE,
+	CMD_WRITE_FRAME,
+	CMD_QUERY_STAMP
+};
+
+union CommandArg {
+	int i;
+	float f;
+
+	CommandArg() : i(0) {}
+	CommandArg(int i) : i(i) {}
+	CommandArg(float f) : f(f) {}
+};
+
+struct Command {
+	int op;
+	CommandArg args[4];
+};
+
+/*
+Single producer, single consumer ring of recorded calls, see EXT_OLC_ASYNC. The app thread writes
+commands and publishes head, the render thread executes them and publishes tail, neither takes a lock
+while there is work. Positions only grow, a position lives in slot position & (GL_RING_SIZE - 1).
+
+The render thread spins a little once it caught up and then sleeps, kick wakes it. Waiting for a
+position (fences, glFinish, a full ring) sleeps on done, the render thread only signals it when someone
+waits. Both use the sleeping / waiters flags with sequentially consistent accesses so a wakeup is never lost.
+*/
+struct CommandRing {
+	Command slots[GL_RING_SIZE];
+
+	// App thread
+	unsigned long long issued;
+	std::atomic<unsigned long long> head;
+	char padHead[64];
+
+	// Render thread
+	std::atomic<unsigned long long> tail;
+	char padTail[64];
+	// Nanoseconds spent executing, up to batchStart, see GL_TIME_ELAPSED
+	unsigned long long busyTime;
+	std::chrono::steady_clock::time_point batchStart;
+
+	std::atomic<bool> sleeping;
+	std::atomic<int> waiters;
+	std::atomic<bool> quit;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::thread thread;
+
+	CommandRing(unsigned long long position)
+		:	issued(position),
+			head(position),
+			tail(position),
+			busyTime(0),
+			sleeping(false),
+			waiters(0),
+			quit(false)
+	{
+
+	}
+
+	Command& slot(unsigned long long position) {
+		return slots[position & (GL_RING_SIZE - 1)];
+	}
+
+	// Make room for count commands
+	void reserve(int count) {
+		if (issued + count - tail.load(std::memory_order_acquire) > GL_RING_SIZE) {
+			kick();
+			waitFor(issued + count - GL_RING_SIZE, ~0ull);
+		}
+	}
+
+	// Only valid after reserve, the command is not visible before publish
+	void write(int op, CommandArg a0 = CommandArg(), CommandArg a1 = CommandArg(), CommandArg a2 = CommandArg(), CommandArg a3 = CommandArg()) {
+		Command& command = slot(issued++);
+		command.op = op;
+		command.args[0] = a0;
+		command.args[1] = a1;
+		command.args[2] = a2;
+		command.args[3] = a3;
+	}
+
+	void publish() {
+		head.store(issued, std::memory_order_release);
+	}
+
+	// Wake the render thread if it went to sleep
+	void kick() {
+		head.store(issued, std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_seq_cst)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			wake.notify_one();
+		}
+	}
+
+	// Wait until the render thread executed everything before position, false on timeout (in ns)
+	bool waitFor(unsigned long long position, unsigned long long timeout) {
+		if (tail.load(std::memory_order_acquire) >= position) return true;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		waiters++;
+		auto completed = [&] { return tail.load(std::memory_order_seq_cst) >= position; };
+
+		bool reached;
+		if (timeout == ~0ull) {
+			done.wait(lock, completed);
+			reached = true;
+		}
+		else {
+			reached = done.wait_for(lock, std::chrono::nanoseconds((long long)glm::min(timeout, 1ull << 62)), completed);
+		}
+		waiters--;
+		return reached;
+	}
+
+	void finish() {
+		kick();
+		waitFor(issued, ~0ull);
+	}
+
+	void stop() {
+		finish();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+			wake.notify_one();
+		}
+
+		if (thread.joinable()) thread.join();
+	}
+
+	void run(GLContext* ctx);
+	int execute(unsigned long long position);
+};
+#pragma endregion
+
+typedef void (*BlendKernel)(Pixel* dst, const Pixel* src, int count);
+
+void blendReplace(Pixel* dst, const Pixel* src, int count);
+
+// Everything the raster kernels read besides the vertices, see EXT_OLC_DEFERRED
+struct DrawState {
+	Texture* texture;
+	bool depthEnabled;
+	bool cullingEnabled;
+	bool alphaTestEnabled;
+	bool blendEnabled;
+	int alphaFunc;
+	float alphaRef;
+	int blendSrc;
+	int blendDst;
+	BlendKernel blendKernel;
+
+	bool operator==(const DrawState& other) const {
+		return texture == other.texture && depthEnabled == other.depthEnabled && cullingEnabled == other.cullingEnabled &&
+			alphaTestEnabled == other.alphaTestEnabled && blendEnabled == other.blendEnabled && alphaFunc == other.alphaFunc &&
+			alphaRef == other.alphaRef && blendSrc == other.blendSrc && blendDst == other.blendDst && blendKernel == other.blendKernel;
+	}
+};
+
+// A glBegin/glEnd batch waiting for the flush, its transformed vertices are in GLContext::deferVertices
+struct DeferredDraw {
+	int state;
+	int mode;
+	size_t first;
+	size_t count;
+	float depth;
+	bool sortable;
+};
+
+/*
+GL_TIME_ELAPSED query. The app thread owns position and ended, whoever executes the calls writes start
+and result. position is the ring position after glEndQuery, the result is valid once it was reached.
+*/
+struct TimeQuery {
+	unsigned long long start;
+	unsigned long long result;
+	unsigned long long position;
+	bool ended;
+};
+
+struct GLContext {
+	int w, h;
+
+	// Color and depth share a single 64 byte aligned allocation
+	int colorFormat;
+	int depthFormat;
+	void* framebuffer;
+	void* bufColor;
+	void* bufDepth;
+	const RasterKernels* raster;
+
+	// glReadPixels client memory layout and how many threads convert it
+	int packRowLength;
+	int packAlignment;
+	int packThreads;
+
+	// Pending clears, see GL_TILE_SIZE
+	int tilesX, tilesY;
+	std::vector<unsigned char> tileFlags;
+	std::vector<int> dirtyRects;
+	Pixel tileColorClear;
+	float tileDepthClear;
+
+	glm::mat4 matModelView;
+	glm::mat4 matProj;
+	glm::mat4* curMatrix;
+
+	int err;
+
+	Pixel bufColorClear;
+	float bufDepthClear;
+
+	int beginMode;
+	Pixel beginColor;
+	glm::vec2 beginTexCoord;
+
+	ShareGroup* group;
+	Texture* curTexture;
+	const Texture* boundTexture;
+	BlockCache blockCache;
+	unsigned int blockCacheGeneration;
+
+	Buffer* curPackBuffer;
+	ReadbackWorker* readback;
+	ConvertPool convertPool;
+
+	ObjectPool<FrameSink*> frameSinks;
+
+	// Set while EXT_OLC_ASYNC is enabled, ring positions continue across enables so fences stay ordered
+	CommandRing* commands;
+	unsigned long long commandsRetired;
+	ObjectPool<unsigned long long> fences;
+	ObjectPool<TimeQuery> queries;
+	int activeQuery;
+
+	bool depthEnabled;
+	bool cullingEnabled;
+	bool textureEnabled;
+	bool alphaTestEnabled;
+	bool blendEnabled;
+	bool extOlcSlowColor;
+	bool extOlcDirtyTiles;
+	bool extOlcDeferred;
+
+	int alphaFunc;
+	float alphaRef;
+
+	int blendSrc;
+	int blendDst;
+	BlendKernel blendKernel;
+
+	std::vector<Vertex> beginVertices;
+
+	// Draws recorded since the last flush, the states hold a reference to their texture
+	std::vector<DrawState> deferStates;
+	std::vector<DeferredDraw> deferDraws;
+	std::vector<Vertex> deferVertices;
+	std::vector<int> deferOrder;
+	
+	GLContext(int w, int h, ShareGroup* group, ReadbackWorker* readback)
+		:	w(w),
+			h(h),
+			colorFormat(GL_RGBA32F),
+			depthFormat(GL_DEPTH_COMPONENT32F),
+			framebuffer(nullptr),
+			bufColor(nullptr),
+			bufDepth(nullptr),
+			raster(nullptr),
+			packRowLength(0),
+			packAlignment(4),
+			packThreads(1),
+			tilesX(0),
+			tilesY(0),
+			tileDepthClear(0.0f),
+			matModelView(glm::mat4(1.0f)),
+			matProj(glm::mat4(1.0f)),
+			curMatrix(&matModelView),
+			err(GL_NO_ERROR),
+			bufColorClear(Pixel(0.0f, 0.0f, 0.0f, 1.0f)),
+			bufDepthClear(-1.0f),
+			beginMode(-1),
+			beginColor(Pixel(1.0f, 1.0f, 1.0f, 1.0f)),
+			beginTexCoord(glm::vec2(0.0f, 0.0f)),
+			group(group),
+			curTexture(nullptr),
+			boundTexture(nullptr),
+			blockCacheGeneration(0),
+			curPackBuffer(nullptr),
+			readback(readback),
+			commands(nullptr),
+			commandsRetired(0),
+			activeQuery(0),
+			depthEnabled(false),
+			cullingEnabled(false),
+			textureEnabled(false),
+			alphaTestEnabled(false),
+			blendEnabled(false),
+			extOlcSlowColor(false),
+			extOlcDirtyTiles(false),
+			extOlcDeferred(false),
+			alphaFunc(GL_ALWAYS),
+			alphaRef(0.0f),
+			blendSrc(GL_ONE),
+			blendDst(GL_ZERO),
+			blendKernel(blendReplace)
+	{
+
+	}
+
+	~GLContext();
+};
+
+thread_local GLContext* context;
+
+// Set on render threads, their calls execute instead of being recorded again
+thread_local bool executingCommands;
+
+bool recording() {
+	return !executingCommands && context->commands != nullptr;
+}
+
+// Record the call if the context renders asynchronously, false if it should run now
+bool recordCommand(int op, CommandArg a0 = CommandArg(), CommandArg a1 = CommandArg(), CommandArg a2 = CommandArg(), CommandArg a3 = CommandArg()) {
+	if (!recording()) return false;
+
+	CommandRing& ring = *context->commands;
+	ring.reserve(1);
+	ring.write(op, a0, a1, a2, a3);
+	ring.publish();
+	return true;
+}
+
+// Calls that read state back or touch objects run on the calling thread, after what was recorded
+void finishCommands() {
+	if (recording()) context->commands->finish();
+}
+
+void flushDraws();
+void discardDraws();
+void stampQuery(int id, bool end);
+
+#pragma region Blending
+/*
+Blend kernels, one per common factor pair plus a generic one, picked once by glBlendFunc. They blend
+a span of fragments at a time, a Pixel is four packed floats so each one is a handful of SSE operations.
+*/
+void blendReplace(Pixel* dst, const Pixel* src, int count) {
+	memcpy(dst, src, count * sizeof(Pixel));
+}
+
+#ifdef GL_SSE
+#define GL_BLEND_LOAD(pixel) _mm_loadu_ps(&(pixel).a)
+#define GL_BLEND_STORE(pixel, v) _mm_storeu_ps(&(pixel).a, v)
+#define GL_BLEND_ALPHA(v) _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))
+
+void blendAlpha(Pixel* dst, const Pixel* src, int count) {
+	for (int i = 0; i < count; i++) {
+		__m128 s = GL_BLEND_LOAD(src[i]);
+		__m128 d = GL_BLEND_LOAD(dst[i]);
+		GL_BLEND_STORE(dst[i], _mm_add_ps(d, _mm_mul_ps(_mm_sub_ps(s, d), GL_BLEND_ALPHA(s))));
+	}
+}
+
+void blendAdditive(Pixel* dst, const Pixel* src, int count) {
+	__m128 one = _mm_set1_ps(1.0f);
+	for (int i = 0; i < count; i++) {
+		__m128 s = GL_BLEND_LOAD(src[i]);
+		__m128 d = GL_BLEND_LOAD(dst[i]);
+		GL_BLEND_STORE(dst[i], _mm_min_ps(_mm_add_ps(s, d), one));
+	}
+}
+
+void blendPremultiplied(Pixel* dst, const Pixel* src, int count) {
+	__m128 one = _mm_set1_ps(1.0f);
+	for (int i = 0; i < count; i++) {
+		__m128 s = GL_BLEND_LOAD(src[i]);
+		__m128 d = GL_BLEND_LOAD(dst[i]);
+		__m128 invAlpha = _mm_sub_ps(one, GL_BLEND_ALPHA(s));
+		GL_BLEND_STORE(dst[i], _mm_min_ps(_mm_add_ps(s, _mm_mul_ps(d, invAlpha)), one));
+	}
+}
+#else
+void blendAlpha(Pixel* dst, const Pixel* src, int count) {
+	for (int i = 0; i < count; i++) {
+		dst[i].r += (src[i].r - dst[i].r) * src[i].a;
+		dst[i].g += (src[i].g - dst[i].g) * src[i].a;
+		dst[i].b += (src[i].b - dst[i].b) * src[i].a;
+		dst[i].a += (src[i].a - dst[i].a) * src[i].a;
+	}
+}
+
+void blendAdditive(Pixel* dst, const Pixel* src, int count) {
+	for (int i = 0; i < count; i++) {
+		dst[i] = Pixel(src[i].r + dst[i].r, src[i].g + dst[i].g, src[i].b + dst[i].b, src[i].a + dst[i].a);
+	}
+}
+
+void blendPremultiplied(Pixel* dst, const Pixel* src, int count) {
+	for (int i = 0; i < count; i++) {
+		float invAlpha = 1.0f - src[i].a;
+		dst[i] = Pixel(src[i].r + dst[i].r * invAlpha, src[i].g + dst[i].g * invAlpha, src[i].b + dst[i].b * invAlpha, src[i].a + dst[i].a * invAlpha);
+	}
+}
+#endif
+
+Pixel blendFactor(int factor, const Pixel& src, const Pixel& dst) {
+	switch (factor) {
+	case GL_ZERO: return Pixel(0.0f, 0.0f, 0.0f, 0.0f);
+	case GL_ONE: return Pixel(1.0f, 1.0f, 1.0f, 1.0f);
+	case GL_SRC_COLOR: return src;
+	case GL_ONE_MINUS_SRC_COLOR: return Pixel(1.0f - src.r, 1.0f - src.g, 1.0f - src.b, 1.0f - src.a);
+	case GL_SRC_ALPHA: return Pixel(src.a, src.a, src.a, src.a);
+	case GL_ONE_MINUS_SRC_ALPHA: return Pixel(1.0f - src.a, 1.0f - src.a, 1.0f - src.a, 1.0f - src.a);
+	case GL_DST_ALPHA: return Pixel(dst.a, dst.a, dst.a, dst.a);
+	case GL_ONE_MINUS_DST_ALPHA: return Pixel(1.0f - dst.a, 1.0f - dst.a, 1.0f - dst.a, 1.0f - dst.a);
+	case GL_DST_COLOR: return dst;
+	case GL_ONE_MINUS_DST_COLOR: return Pixel(1.0f - dst.r, 1.0f - dst.g, 1.0f - dst.b, 1.0f - dst.a);
+	default: {
+		// GL_SRC_ALPHA_SATURATE
+		float f = glm::min(src.a, 1.0f - dst.a);
+		return Pixel(f, f, f, 1.0f);
+	}
+	}
+}
+
+void blendGeneric(Pixel* dst, const Pixel* src, int count) {
+	int srcFactor = context->blendSrc;
+	int dstFactor = context->blendDst;
+	for (int i = 0; i < count; i++) {
+		Pixel sf = blendFactor(srcFactor, src[i], dst[i]);
+		Pixel df = blendFactor(dstFactor, src[i], dst[i]);
+		dst[i] = Pixel(	src[i].r * sf.r + dst[i].r * df.r,
+						src[i].g * sf.g + dst[i].g * df.g,
+						src[i].b * sf.b + dst[i].b * df.b,
+						src[i].a * sf.a + dst[i].a * df.a);
+	}
+}
+#pragma endregion
+
+void allocateFramebuffer(int colorFormat, int depthFormat);
+void initOlcCellLut();
+
+#pragma region Share Groups
+// The group mutex is held by the callers of these
+
+void freeTexture(ShareGroup& group, Texture* texture) {
+	if (texture->texels != nullptr) group.texelPool.release(texture->texels, texture->sizeClass);
+	if (texture->palette != nullptr) group.texelPool.release(texture->palette, texture->paletteClass);
+	group.texelGeneration++;
+	delete texture;
+}
+
+void unrefTexture(ShareGroup& group, Texture* texture) {
+	if (texture != nullptr && --texture->refs == 0) freeTexture(group, texture);
+}
+
+void waitReadback(const Buffer& buffer) {
+	if (buffer.writer != nullptr) buffer.writer->wait(buffer.lastJob);
+}
+
+// Readbacks still writing the buffer finish first
+void freeBuffer(Buffer* buffer) {
+	waitReadback(*buffer);
+	alignedFree(buffer->data);
+	delete buffer;
+}
+
+void unrefBuffer(Buffer* buffer) {
+	if (buffer != nullptr && --buffer->refs == 0) freeBuffer(buffer);
+}
+
+// Every context is gone, so only the names hold references and the workers are stopped
+ShareGroup::~ShareGroup() {
+	for (size_t i = 0; i < buffers.slots.size(); i++) {
+		if (buffers.slots[i].alive) freeBuffer(buffers.slots[i].object);
+	}
+
+	for (size_t i = 0; i < textures.slots.size(); i++) {
+		if (textures.slots[i].alive) freeTexture(*this, textures.slots[i].object);
+	}
+}
+
+GLContext::~GLContext() {
+	if (commands != nullptr) {
+		commands->stop();
+		delete commands;
+	}
+
+	readback->stop();
+	convertPool.stop();
+
+	for (size_t i = 0; i < frameSinks.slots.size(); i++) {
+		if (frameSinks.slots[i].alive) delete frameSinks.slots[i].object;
+	}
+
+	bool last;
+	{
+		std::lock_guard<std::mutex> lock(group->mutex);
+		unrefTexture(*group, curTexture);
+		unrefBuffer(curPackBuffer);
+		for (size_t i = 0; i < deferStates.size(); i++) {
+			unrefTexture(*group, deferStates[i].texture);
+		}
+		group->idleWorkers.push_back(readback);
+		last = --group->contexts == 0;
+	}
+	if (last) delete group;
+
+	alignedFree(framebuffer);
+}
+#pragma endregion
+
+void allocateFramebuffer(int colorFormat, int depthFormat);
+void initOlcCellLut();
+
+// The context glInit made current on this thread, replaced by the next glInit
+thread_local GLContext* initContext;
+
+bool glInit(int w, int h)
+{
+	GLContext* created = glCreateContextEXT(w, h, nullptr);
+	if (created == nullptr) return false;
+
+	if (initContext != nullptr) glDestroyContextEXT(initContext);
+
+	initContext = created;
+	glMakeCurrentEXT(initContext);
+	return true;
+}
+
+GLContext* glCreateContextEXT(int w, int h, GLContext* share) {
+	if (w <= 0 || h <= 0) return nullptr;
+
+	initOlcCellLut();
+
+	ShareGroup* group = share != nullptr ? share->group : new ShareGroup();
+	ReadbackWorker* readback;
+	{
+		std::lock_guard<std::mutex> lock(group->mutex);
+		group->contexts++;
+		readback = group->takeWorker();
+	}
+
+	// allocateFramebuffer works on the current context
+	GLContext* current = context;
+	context = new GLContext(w, h, group, readback);
+	allocateFramebuffer(GL_RGBA32F, GL_DEPTH_COMPONENT32F);
+
+	GLContext* created = context;
+	context = current;
+	return created;
+}
+
+void glDestroyContextEXT(GLContext* ctx) {
+	if (ctx == context) context = nullptr;
+	if (ctx == initContext) initContext = nullptr;
+	delete ctx;
+}
+
+void glMakeCurrentEXT(GLContext* ctx) {
+	context = ctx;
+}
+
+GLContext* glGetCurrentContextEXT() {
+	return context;
+}
+
+const char* glGetString(int string) {
+	finishCommands();
+	switch (string) {
+		case GL_VENDOR: return "Itay Almog";
+		case GL_RENDERER: return "Software Based (C++)";
+		case GL_VERSION: return "OpenGL 1.1 WIN32";
+		case GL_EXTENSIONS: return "EXT_OLC";
+	default:
+		context->err = GL_INVALID_ENUM;
+		return nullptr;
+	}
+}
+
+// Cells depend on more than the color buffer, e.g. the classification
+void markTilesDirty() {
+	for (size_t i = 0; i < context->tileFlags.size(); i++) {
+		context->tileFlags[i] |= GL_TILE_DIRTY | GL_TILE_SINK_DIRTY;
+	}
+}
+
+void setAsync(bool enable);
+
+void glEnable(int capability) {
+	if (capability == EXT_OLC_ASYNC) {
+		setAsync(true);
+		return;
+	}
+	if (recordCommand(CMD_ENABLE, capability)) return;
+
+	GL_BEGIN_CHECK;
+
+	switch (capability) {
+	case GL_DEPTH_TEST: context->depthEnabled = true; break;
+	case GL_CULL_FACE: context->cullingEnabled = true; break;
+	case GL_TEXTURE_2D: context->textureEnabled = true; break;
+	case GL_ALPHA_TEST: context->alphaTestEnabled = true; break;
+	case GL_BLEND: context->blendEnabled = true; break;
+	case EXT_OLC_SLOW_COLOR: context->extOlcSlowColor = true; markTilesDirty(); break;
+	case EXT_OLC_DIRTY_TILES: context->extOlcDirtyTiles = true; break;
+	case EXT_OLC_DEFERRED: context->extOlcDeferred = true; break;
+	default:
+		context->err = GL_INVALID_ENUM;
+	}
+}
+
+void glDisable(int capability) {
+	if (capability == EXT_OLC_ASYNC) {
+		setAsync(false);
+		return;
+	}
+	if (recordCommand(CMD_DISABLE, capability)) return;
+
+	GL_BEGIN_CHECK;
+
+	switch (capability) {
+	case GL_DEPTH_TEST: context->depthEnabled = false; break;
+	case GL_CULL_FACE: context->cullingEnabled = false; break;
+	case GL_TEXTURE_2D: context->textureEnabled = false; break;
+	case GL_ALPHA_TEST: context->alphaTestEnabled = false; break;
+	case GL_BLEND: context->blendEnabled = false; break;
+	case EXT_OLC_SLOW_COLOR: context->extOlcSlowColor = false; markTilesDirty(); break;
+	case EXT_OLC_DIRTY_TILES: context->extOlcDirtyTiles = false; break;
+	case EXT_OLC_DEFERRED: flushDraws(); context->extOlcDeferred = false; break;
+	default:
+		context->err = GL_INVALID_ENUM;
+	}
+}
+
+int glGetError() {
+	finishCommands();
+	if (context->beginMode != -1) return GL_NO_ERROR;
+	return context->err;
+}
+
+void glClearColor(float r, float g, float b, float a) {
+	if (recordCommand(CMD_CLEAR_COLOR, r, g, b, a)) return;
+
+	GL_BEGIN_CHECK;
+	
+	context->bufColorClear = Pixel(r, g, b, a);
+}
+
+void glClearDepth(float depth) {
+	if (recordCommand(CMD_CLEAR_DEPTH, depth)) return;
+
+	GL_BEGIN_CHECK;
+
+	context->bufDepthClear = depth;
+}
+
+void glClear(int mask) {
+	if (recordCommand(CMD_CLEAR, mask)) {
+		context->commands->kick();
+		return;
+	}
+
+	if (mask - GL_COLOR_BUFFER_BIT - GL_DEPTH_BUFFER_BIT > 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	// Nothing drawn before a full clear can show through it
+	if ((mask & GL_COLOR_BUFFER_BIT) && (mask & GL_DEPTH_BUFFER_BIT)) {
+		discardDraws();
+	}
+	else {
+		flushDraws();
+	}
+
+	unsigned char flags = 0;
+
+	// Tiles still waiting for a clear to the same color do not change
+	bool sameColor = memcmp(&context->tileColorClear, &context->bufColorClear, sizeof(Pixel)) == 0;
+
+	if ((mask & GL_COLOR_BUFFER_BIT) != 0) {
+		context->tileColorClear = context->bufColorClear;
+		flags |= GL_TILE_COLOR_CLEAR;
+	}
+
+	if ((mask & GL_DEPTH_BUFFER_BIT) != 0) {
+		context->tileDepthClear = context->bufDepthClear;
+		flags |= GL_TILE_DEPTH_CLEAR;
+	}
+
+	for (size_t i = 0; i < context->tileFlags.size(); i++) {
+		unsigned char& tile = context->tileFlags[i];
+		if ((flags & GL_TILE_COLOR_CLEAR) && !(sameColor && (tile & GL_TILE_COLOR_CLEAR))) {
+			tile |= GL_TILE_DIRTY | GL_TILE_SINK_DIRTY;
+		}
+		tile |= flags;
+	}
+}
+
+void glAlphaFunc(int func, float ref) {
+	if (recordCommand(CMD_ALPHA_FUNC, func, ref)) return;
+
+	GL_BEGIN_CHECK;
+
+	if (func < GL_NEVER || func > GL_ALWAYS) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	context->alphaFunc = func;
+	context->alphaRef = GL_CLAMP(ref);
+}
+
+bool isBlendFactor(int factor) {
+	return factor == GL_ZERO || factor == GL_ONE || (factor >= GL_SRC_COLOR && factor <= GL_SRC_ALPHA_SATURATE);
+}
+
+void glBlendFunc(int sfactor, int dfactor) {
+	if (recordCommand(CMD_BLEND_FUNC, sfactor, dfactor)) return;
+
+	GL_BEGIN_CHECK;
+
+	if (!isBlendFactor(sfactor) || !isBlendFactor(dfactor) || dfactor == GL_SRC_ALPHA_SATURATE) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	context->blendSrc = sfactor;
+	context->blendDst = dfactor;
+
+	if (sfactor == GL_ONE && dfactor == GL_ZERO) {
+		context->blendKernel = blendReplace;
+	}
+	else if (sfactor == GL_SRC_ALPHA && dfactor == GL_ONE_MINUS_SRC_ALPHA) {
+		context->blendKernel = blendAlpha;
+	}
+	else if (sfactor == GL_ONE && dfactor == GL_ONE) {
+		context->blendKernel = blendAdditive;
+	}
+	else if (sfactor == GL_ONE && dfactor == GL_ONE_MINUS_SRC_ALPHA) {
+		context->blendKernel = blendPremultiplied;
+	}
+	else {
+		context->blendKernel = blendGeneric;
+	}
+}
+
+void glBegin(int mode) {
+	if (recordCommand(CMD_BEGIN, mode)) return;
+
+	GL_BEGIN_CHECK;
+
+	switch (mode) {
+	case GL_POINTS:
+	case GL_LINES:
+	case GL_TRIANGLES:
+	case GL_QUADS:
+		context->beginMode = mode;
+		context->beginVertices.clear();
+		break;
+	default:
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+}
+
+#pragma region Texture Sampling
+Pixel rgb565(unsigned short c) {
+	return Pixel(	((c >> 11) & 0x1F) / 31.0f,
+					((c >> 5) & 0x3F) / 63.0f,
+					(c & 0x1F) / 31.0f,
+					1.0f);
+}
+
+void decodeDxt1Block(const unsigned char* block, bool hasAlpha, Pixel* out) {
+	unsigned short c0 = block[0] | (block[1] << 8);
+	unsigned short c1 = block[2] | (block[3] << 8);
+	unsigned int bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+
+	Pixel colors[4];
+	colors[0] = rgb565(c0);
+	colors[1] = rgb565(c1);
+	if (c0 > c1) {
+		colors[2] = Pixel(	(2 * colors[0].r + colors[1].r) / 3,
+							(2 * colors[0].g + colors[1].g) / 3,
+							(2 * colors[0].b + colors[1].b) / 3,
+							1.0f);
+		colors[3] = Pixel(	(colors[0].r + 2 * colors[1].r) / 3,
+							(colors[0].g + 2 * colors[1].g) / 3,
+							(colors[0].b + 2 * colors[1].b) / 3,
+							1.0f);
+	}
+	else {
+		colors[2] = Pixel(	(colors[0].r + colors[1].r) / 2,
+							(colors[0].g + colors[1].g) / 2,
+							(colors[0].b + colors[1].b) / 2,
+							1.0f);
+		colors[3] = Pixel(0.0f, 0.0f, 0.0f, hasAlpha ? 0.0f : 1.0f);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		out[i] = colors[(bits >> (i * 2)) & 3];
+	}
+}
+
+const Pixel& fetchDxt1(const Texture& tex, int x, int y) {
+	int blocksPerRow = (tex.w + 3) / 4;
+	const unsigned char* block = (const unsigned char*)tex.texels + ((y / 4) * blocksPerRow + (x / 4)) * 8;
+
+	BlockCache& cache = context->blockCache;
+	int slot = (int)(((size_t)block >> 3) & (BlockCache::SIZE - 1));
+	if (cache.keys[slot] != block) {
+		decodeDxt1Block(block, tex.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, cache.texels[slot]);
+		cache.keys[slot] = block;
+	}
+	return cache.texels[slot][(y & 3) * 4 + (x & 3)];
+}
+
+Pixel sampleTexture(const Texture& tex, float u, float v) {
+	// This behaviour should later depend on GL_TEXTURE_WRAP_S
+	int x = (int)glm::floor(u * tex.w) % tex.w;
+	int y = (int)glm::floor(v * tex.h) % tex.h;
+	if (x < 0) x += tex.w;
+	if (y < 0) y += tex.h;
+
+	switch (tex.format) {
+	case GL_COLOR_INDEX8_EXT: {
+		unsigned char index = ((const unsigned char*)tex.texels)[y * tex.w + x];
+		return tex.palette != nullptr ? tex.palette[index] : Pixel();
+	}
+	case GL_COLOR_INDEX4_EXT: {
+		unsigned char packed = ((const unsigned char*)tex.texels)[y * ((tex.w + 1) / 2) + x / 2];
+		unsigned char index = (x & 1) ? (packed & 0x0F) : (packed >> 4);
+		return tex.palette != nullptr ? tex.palette[index] : Pixel();
+	}
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		return fetchDxt1(tex, x, y);
+	case GL_RGBA8: {
+		const unsigned char* texel = (const unsigned char*)tex.texels + (y * tex.w + x) * 4;
+		return Pixel(texel[0], texel[1], texel[2], texel[3]);
+	}
+	default:
+		return ((const Pixel*)tex.texels)[y * tex.w + x];
+	}
+}
+#pragma endregion
+
+#pragma region Tiles
+template<class F, typename T>
+void fillTile(void* buf, int tx, int ty, const T& value) {
+	typename F::Storage encoded = F::encode(value);
+	int x0 = tx << GL_TILE_SHIFT;
+	int y0 = ty << GL_TILE_SHIFT;
+	int x1 = glm::min(x0 + GL_TILE_SIZE, context->w);
+	int y1 = glm::min(y0 + GL_TILE_SIZE, context->h);
+
+	for (int y = y0; y < y1; y++) {
+		typename F::Storage* row = (typename F::Storage*)buf + y * context->w;
+		std::fill(row + x0, row + x1, encoded);
+	}
+}
+
+/*
+Fill the pending clears of every tile overlapping the (inclusive) pixel rectangle and mark them dirty.
+Depth is only filled while depth testing, nothing reads or writes it otherwise.
+*/
+template<class C, class D>
+void resolveTiles(int minX, int minY, int maxX, int maxY) {
+	unsigned char mask = GL_TILE_COLOR_CLEAR | (context->depthEnabled ? GL_TILE_DEPTH_CLEAR : 0);
+
+	for (int ty = minY >> GL_TILE_SHIFT; ty <= (maxY >> GL_TILE_SHIFT); ty++) {
+		for (int tx = minX >> GL_TILE_SHIFT; tx <= (maxX >> GL_TILE_SHIFT); tx++) {
+			unsigned char& flags = context->tileFlags[ty * context->tilesX + tx];
+			flags |= GL_TILE_DIRTY | GL_TILE_SINK_DIRTY;
+			if ((flags & mask) == 0) continue;
+
+			if (flags & mask & GL_TILE_COLOR_CLEAR) fillTile<C>(context->bufColor, tx, ty, context->tileColorClear);
+			if (flags & mask & GL_TILE_DEPTH_CLEAR) fillTile<D>(context->bufDepth, tx, ty, context->tileDepthClear);
+			flags &= ~mask;
+		}
+	}
+}
+#pragma endregion
+
+#pragma region Fragment Operations
+bool alphaTest(float alpha) {
+	float ref = context->alphaRef;
+	switch (context->alphaFunc) {
+	case GL_NEVER: return false;
+	case GL_LESS: return alpha < ref;
+	case GL_EQUAL: return alpha == ref;
+	case GL_LEQUAL: return alpha <= ref;
+	case GL_GREATER: return alpha > ref;
+	case GL_NOTEQUAL: return alpha != ref;
+	case GL_GEQUAL: return alpha >= ref;
+	default: return true;
+	}
+}
+
+
+#define GL_SPAN_SIZE			(64)
+
+/*
+A run of adjacent fragments of a primitive waiting to be blended, flushed when the run breaks, at the
+end of every row and when it is full, so the blend kernel runs once per run instead of per fragment.
+*/
+struct FragmentSpan {
+	BlendKernel kernel;
+	int start;
+	int count;
+	Pixel colors[GL_SPAN_SIZE];
+	Pixel dst[GL_SPAN_SIZE];
+
+	// Picked once per primitive, null when fragments are written as they are
+	FragmentSpan()
+		:	kernel(context->blendEnabled && context->blendKernel != blendReplace ? context->blendKernel : nullptr),
+			start(0),
+			count(0)
+	{
+
+	}
+};
+
+template<class C>
+void blendSpan(typename C::Storage* color, FragmentSpan& span) {
+	for (int i = 0; i < span.count; i++) {
+		span.dst[i] = C::decode(color[i]);
+	}
+
+	span.kernel(span.dst, span.colors, span.count);
+
+	for (int i = 0; i < span.count; i++) {
+		color[i] = C::encode(span.dst[i]);
+	}
+}
+
+// The buffer already holds Pixels, they are blended in place
+template<>
+void blendSpan<ColorRGBA32F>(Pixel* color, FragmentSpan& span) {
+	span.kernel(color, span.colors, span.count);
+}
+
+template<class C>
+void flushFragments(FragmentSpan& span) {
+	if (span.count == 0) return;
+
+	blendSpan<C>((typename C::Storage*)context->bufColor + span.start, span);
+	span.count = 0;
+}
+
+/*
+Finish a shaded fragment. The depth test already rejected hidden fragments before shading,
+the alpha test runs on the fetched texel and a discarded fragment writes neither depth nor color.
+Blended fragments are queued in span, the others are written right away.
+*/
+template<class C, class D>
+void writeFragment(FragmentSpan& span, int o, float z, const Pixel& fragColor) {
+	if (context->alphaTestEnabled && !alphaTest(fragColor.a)) return;
+
+	if (context->depthEnabled) {
+		((typename D::Storage*)context->bufDepth)[o] = D::encode(z);
+	}
+
+	if (span.kernel != nullptr) {
+		if (span.count == GL_SPAN_SIZE || (span.count > 0 && o != span.start + span.count)) flushFragments<C>(span);
+		if (span.count == 0) span.start = o;
+		span.colors[span.count++] = fragColor;
+	}
+	else {
+		((typename C::Storage*)context->bufColor)[o] = C::encode(fragColor);
+	}
+}
+
+template<class D>
+bool depthPasses(int o, float z) {
+	return D::encode(z) <= ((const typename D::Storage*)context->bufDepth)[o];
+}
+#pragma endregion
+
+template<class C, class D>
+void drawPoint(Vertex p) {
+	int x = (int)glm::floor(p.coord.x);
+	int y = (int)glm::floor(p.coord.y);
+	if (x < 0 || y < 0 || x >= context->w || y >= context->h) return;
+
+	resolveTiles<C, D>(x, y, x, y);
+	int o = x + y * context->w;
+
+	if (context->depthEnabled && !depthPasses<D>(o, p.coord.z)) return;
+
+	// Vertex Color
+	Pixel fragColor = p.color;
+
+	// Texture samples
+	if (context->boundTexture != nullptr) {
+		Pixel texel = sampleTexture(*context->boundTexture, p.texCoord.x, p.texCoord.y);
+		fragColor.r *= texel.r;
+		fragColor.g *= texel.g;
+		fragColor.b *= texel.b;
+		fragColor.a *= texel.a;
+	}
+
+	FragmentSpan span;
+	writeFragment<C, D>(span, o, p.coord.z, fragColor);
+	flushFragments<C>(span);
+}
+
+template<class C, class D>
+void drawLine(Vertex p1, Vertex p2) {
+	int x0 = (int)glm::floor(p1.coord.x);
+	int y0 = (int)glm::floor(p1.coord.y);
+	int x1 = (int)glm::ceil(p2.coord.x);
+	int y1 = (int)glm::ceil(p2.coord.y);
+	int dx = glm::abs(x1 - x0);
+	int dy = glm::abs(y1 - y0);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx - dy;
+
+	int minX = glm::max(glm::min(x0, x1), 0);
+	int minY = glm::max(glm::min(y0, y1), 0);
+	int maxX = glm::min(glm::max(x0, x1), context->w - 1);
+	int maxY = glm::min(glm::max(y0, y1), context->h - 1);
+	if (minX > maxX || minY > maxY) return;
+
+	resolveTiles<C, D>(minX, minY, maxX, maxY);
+
+	FragmentSpan span;
+	int totDist = dx > dy ? dx : dy;
+	while (true) {
+		float ic0 = glm::abs(dx > dy ? (x1 - x0) : (y1 - y0)) / totDist;
+		float ic1 = 1.0 - ic0;
+
+		int o = (x0 + y0 * context->w);
+		float z = 1 / (ic0 * 1 / p1.coord.z + ic1 * 1 / p2.coord.z);
+		bool inside = x0 >= 0 && y0 >= 0 && x0 < context->w && y0 < context->h;
+		if (inside && (!context->depthEnabled || depthPasses<D>(o, z))) {
+			// Vertex Color
+			Pixel fragColor;
+			fragColor.r = (ic0*p1.color.r / p1.coord.z + ic1 * p2.color.r / p2.coord.z) * z;
+			fragColor.g = (ic0*p1.color.g / p1.coord.z + ic1 * p2.color.g / p2.coord.z) * z;
+			fragColor.b = (ic0*p1.color.b / p1.coord.z + ic1 * p2.color.b / p2.coord.z) * z;
+			fragColor.a = (ic0*p1.color.a / p1.coord.z + ic1 * p2.color.a / p2.coord.z) * z;
+
+			// Texture sample
+			if (context->boundTexture != nullptr) {
+				float u = (ic0*p1.texCoord.x / p1.coord.z + ic1 * p2.texCoord.x / p2.coord.z) * z;
+				float v = (ic0*p1.texCoord.y / p1.coord.z + ic1 * p2.texCoord.y / p2.coord.z) * z;
+
+				Pixel texel = sampleTexture(*context->boundTexture, u, v);
+				fragColor.r *= texel.r;
+				fragColor.g *= texel.g;
+				fragColor.b *= texel.b;
+				fragColor.a *= texel.a;
+			}
+
+			writeFragment<C, D>(span, o, z, fragColor);
+		}
+
+		if (x0 == x1 && y0 == y1) break;
+
+		float e2 = 2 * err;
+		if (e2 > -dy) {
+			err -= dy;
+			x0 += sx;
+		}
+		if(e2 < dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+	flushFragments<C>(span);
+}
+
+bool ownsEdge(int a, int b) {
+	return a > 0 || (a == 0 && b > 0);
+}
+
+template<class C, class D>
+void drawTriangle(Vertex p1, Vertex p2, Vertex p3) {
+	if (context->cullingEnabled && !p1.cull) return;
+
+	int x1 = (int)glm::floor(p1.coord.x);
+	int x2 = (int)glm::floor(p2.coord.x);
+	int x3 = (int)glm::floor(p3.coord.x);
+	int y1 = (int)glm::floor(p1.coord.y);
+	int y2 = (int)glm::floor(p2.coord.y);
+	int y3 = (int)glm::floor(p3.coord.y);
+
+	// Bounding box, clipped to the framebuffer
+	int minX = glm::max((int)glm::min(x1, glm::min(x2, x3)), 0);
+	int minY = glm::max((int)glm::min(y1, glm::min(y2, y3)), 0);
+	int maxX = glm::min((int)glm::max(x1, glm::max(x2, x3)), context->w - 1);
+	int maxY = glm::min((int)glm::max(y1, glm::max(y2, y3)), context->h - 1);
+	if (minX > maxX || minY > maxY) return;
+
+	int area = (y2 - y3)*(x1 - x3) + (x3 - x2)*(y1 - y3);
+	if (area == 0) return;
+
+	// Orient the edge functions so inside is positive whatever the winding
+	int sign = area > 0 ? 1 : -1;
+	float factor = 1.0f / (area * sign);
+
+	resolveTiles<C, D>(minX, minY, maxX, maxY);
+
+	// Fill rule: a pixel exactly on an edge belongs to only one of the two triangles sharing
+	// it, otherwise blended quads get a double blended diagonal
+	int bias0 = ownsEdge(sign * (y2 - y3), sign * (x3 - x2)) ? 0 : 1;
+	int bias1 = ownsEdge(sign * (y3 - y1), sign * (x1 - x3)) ? 0 : 1;
+	int bias2 = ownsEdge(sign * (y1 - y2), sign * (x2 - x1)) ? 0 : 1;
+
+	// Walk rows so the color and depth reads and writes stay sequential, blending a row at a time
+	FragmentSpan span;
+	int o = 0;
+	for (int y = minY; y <= maxY; y++) {
+		for (int x = minX; x <= maxX; x++) {
+			int e0 = sign * ((y2 - y3)*(x - x3) + (x3 - x2)*(y - y3));
+			if (e0 < bias0) continue;
+			int e1 = sign * ((y3 - y1)*(x - x3) + (x1 - x3)*(y - y3));
+			if (e1 < bias1) continue;
+			int e2 = area * sign - e0 - e1;
+			if (e2 < bias2) continue;
+
+			float ic0 = e0 * factor;
+			float ic1 = e1 * factor;
+			float ic2 = 1.0f - ic0 - ic1;
+
+			o = (x + y * context->w);
+
+			float z = 1 / (ic0 * 1 / p1.coord.z + ic1 * 1 / p2.coord.z + ic2 * 1 / p3.coord.z);
+			if (context->depthEnabled && !depthPasses<D>(o, z)) continue;
+
+			// Vertex color
 			Pixel fragColor;
 			fragColor.r = (ic0*p1.color.r / p1.coord.z + ic1 * p2.color.r / p2.coord.z + ic2 * p3.color.r / p3.coord.z) * z;
 			fragColor.g = (ic0*p1.color.g / p1.coord.z + ic1 * p2.color.g / p2.coord.z + ic2 * p3.color.g / p3.coord.z) * z;
 			fragColor.b = (ic0*p1.color.b / p1.coord.z + ic1 * p2.color.b / p2.coord.z + ic2 * p3.color.b / p3.coord.z) * z;
 			fragColor.a = (ic0*p1.color.a / p1.coord.z + ic1 * p2.color.a / p2.coord.z + ic2 * p3.color.a / p3.coord.z) * z;
 
-			// Texture sample
-			if (context->textureEnabled && context->curTexture != -1) {
-				const Texture& tex = context->textures[context->curTexture];
-				float u = (ic0*p1.texCoord.x / p1.coord.z + ic1 * p2.texCoord.x / p2.coord.z + ic2 * p3.texCoord.x / p3.coord.z) * z;
-				float v = (ic0*p1.texCoord.y / p1.coord.z + ic1 * p2.texCoord.y / p2.coord.z + ic2 * p3.texCoord.y / p3.coord.z) * z;
-				u = (float)((int)glm::floor(u * tex.w) % tex.w); // This behaviour should later depend on GL_TEXTURE_WRAP_S
-				v = (float)((int)glm::floor(v * tex.h) % tex.h);
-
-				int to = (int)(u + v * tex.w);
-				fragColor.r *= tex.pixels[to].r;
-				fragColor.g *= tex.pixels[to].g;
-				fragColor.b *= tex.pixels[to].b;
-				fragColor.a *= tex.pixels[to].a;
+			// Texture sample
+			if (context->boundTexture != nullptr) {
+				float u = (ic0*p1.texCoord.x / p1.coord.z + ic1 * p2.texCoord.x / p2.coord.z + ic2 * p3.texCoord.x / p3.coord.z) * z;
+				float v = (ic0*p1.texCoord.y / p1.coord.z + ic1 * p2.texCoord.y / p2.coord.z + ic2 * p3.texCoord.y / p3.coord.z) * z;
+
+				Pixel texel = sampleTexture(*context->boundTexture, u, v);
+				fragColor.r *= texel.r;
+				fragColor.g *= texel.g;
+				fragColor.b *= texel.b;
+				fragColor.a *= texel.a;
+			}
+
+			writeFragment<C, D>(span, o, z, fragColor);
+		}
+		flushFragments<C>(span);
+	}
+}
+
+template<class C, class D>
+void drawQuad(Vertex p1, Vertex p2, Vertex p3, Vertex p4) {
+	if (context->cullingEnabled) {
+		if (!p1.cull) return;
+		p3.cull = true; // Or drawTriangle will think the second triangle making the quad is culled
+	}
+
+	drawTriangle<C, D>(p1, p2, p3);
+	drawTriangle<C, D>(p3, p4, p1);
+}
+
+template<class C, class D>
+struct RasterKernelsFor {
+	static const RasterKernels kernels;
+};
+
+template<class C, class D>
+const RasterKernels RasterKernelsFor<C, D>::kernels = { drawPoint<C, D>, drawLine<C, D>, drawTriangle<C, D>, drawQuad<C, D> };
+
+template<class C>
+const RasterKernels* selectRasterKernels(int depthFormat) {
+	switch (depthFormat) {
+	case GL_DEPTH_COMPONENT16: return &RasterKernelsFor<C, DepthU16>::kernels;
+	case GL_DEPTH_COMPONENT24: return &RasterKernelsFor<C, DepthU24>::kernels;
+	default: return &RasterKernelsFor<C, DepthF32>::kernels;
+	}
+}
+
+const RasterKernels* selectRasterKernels(int colorFormat, int depthFormat) {
+	switch (colorFormat) {
+	case GL_RGBA8: return selectRasterKernels<ColorRGBA8>(depthFormat);
+	case GL_RGB565: return selectRasterKernels<ColorRGB565>(depthFormat);
+	case EXT_OLC_PIXEL_FORMAT: return selectRasterKernels<ColorOlcCell>(depthFormat);
+	default: return selectRasterKernels<ColorRGBA32F>(depthFormat);
+	}
+}
+
+size_t alignTo64(size_t size) {
+	return (size + 63) & ~(size_t)63;
+}
+
+/*
+(Re)allocate the color and depth buffers of the current context in the given formats and
+clear them, the previous contents are lost
+*/
+void allocateFramebuffer(int colorFormat, int depthFormat) {
+	size_t pixels = (size_t)context->w * context->h;
+	size_t colorSize = alignTo64(pixels * colorFormatSize(colorFormat));
+	size_t depthSize = alignTo64(pixels * depthFormatSize(depthFormat));
+
+	alignedFree(context->framebuffer);
+	context->framebuffer = alignedAlloc(colorSize + depthSize);
+	context->bufColor = context->framebuffer;
+	context->bufDepth = (char*)context->framebuffer + colorSize;
+	context->colorFormat = colorFormat;
+	context->depthFormat = depthFormat;
+	context->raster = selectRasterKernels(colorFormat, depthFormat);
+
+	context->tilesX = (context->w + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT;
+	context->tilesY = (context->h + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT;
+	context->tileFlags.assign(context->tilesX * context->tilesY, GL_TILE_DIRTY | GL_TILE_SINK_DIRTY);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void glFramebufferFormatEXT(int colorFormat, int depthFormat) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if ((colorFormat != GL_RGBA32F && colorFormat != GL_RGBA8 && colorFormat != GL_RGB565 && colorFormat != EXT_OLC_PIXEL_FORMAT) ||
+		(depthFormat != GL_DEPTH_COMPONENT32F && depthFormat != GL_DEPTH_COMPONENT16 && depthFormat != GL_DEPTH_COMPONENT24)) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	allocateFramebuffer(colorFormat, depthFormat);
+}
+
+void glFramebufferSizeEXT(int w, int h) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (w <= 0 || h <= 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	context->w = w;
+	context->h = h;
+	allocateFramebuffer(context->colorFormat, context->depthFormat);
+}
+
+// The texture draws sample with the current state, null if texturing is off or it has no texels
+Texture* drawTexture() {
+	if (context->textureEnabled && context->curTexture != nullptr && context->curTexture->texels != nullptr) {
+		return context->curTexture;
+	}
+	return nullptr;
+}
+
+// Draws hold a reference to their texture (the bind or a deferred state), so it stays valid without locking
+void bindDrawTexture(const Texture* texture) {
+	context->boundTexture = texture;
+	if (texture == nullptr) return;
+
+	unsigned int generation = context->group->texelGeneration;
+	if (context->blockCacheGeneration != generation) {
+		context->blockCache.invalidate();
+		context->blockCacheGeneration = generation;
+	}
+}
+
+// Assemble primitives
+void rasterize(int mode, const Vertex* vertices, size_t count) {
+	const RasterKernels& raster = *context->raster;
+	switch (mode) {
+	case GL_POINTS:
+		for (size_t i = 0; i < count; i++) {
+			raster.point(vertices[i]);
+		}
+		break;
+	case GL_LINES:
+		for (size_t i = 0; i + 1 < count; i += 2) {
+			raster.line(vertices[i], vertices[i + 1]);
+		}
+		break;
+	case GL_TRIANGLES:
+		for (size_t i = 0; i + 2 < count; i += 3) {
+			raster.triangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+		}
+		break;
+	case GL_QUADS:
+		for (size_t i = 0; i + 3 < count; i += 4) {
+			raster.quad(vertices[i], vertices[i + 1], vertices[i + 2], vertices[i + 3]);
+		}
+		break;
+	}
+}
+
+void deferDraw();
+
+void glEnd() {
+	// A whole primitive batch is ready, get the render thread going on it
+	if (recordCommand(CMD_END)) {
+		context->commands->kick();
+		return;
+	}
+
+	if (context->beginMode == -1) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	// Transform vertives and map them to window coordinates
+	for (size_t i = 0; i < context->beginVertices.size(); i++) {
+		Vertex& vertex = context->beginVertices[i];
+		
+		glm::vec4 vec(vertex.coord.x, vertex.coord.y, vertex.coord.z, 1.0f);
+		vec = context->matModelView * vec;
+
+		// Perform back culling - if enabled
+		if (context->cullingEnabled && ((context->beginMode == GL_QUADS && i % 4 == 0) || (context->beginMode == GL_TRIANGLES && i % 3 == 0))) {
+			glm::vec3 side1 = context->beginVertices[i].coord - context->beginVertices[i + 1].coord;
+			glm::vec3 side2 = context->beginVertices[i].coord - context->beginVertices[i + 2].coord;
+			glm::vec3 normal = glm::cross(side1, side2);
+			float dot = glm::dot(normal, context->beginVertices[i].coord);
+			vertex.cull = dot <= 0;
+		}
+
+		// Transform vertex into clip space
+		vec = context->matProj * vec;
+
+		// Calculate normalized device coordinates
+		glm::vec3 norm(vec.x / vec.w, vec.y / vec.w, vec.z / vec.w);
+
+		vertex.coord.x = (norm.x + 1) / 2 * context->w;
+		vertex.coord.y = (1 - norm.y) / 2 * context->h;
+		vertex.coord.z = norm.z;
+	}
+
+	if (context->extOlcDeferred) {
+		deferDraw();
+	}
+	else {
+		bindDrawTexture(drawTexture());
+		rasterize(context->beginMode, context->beginVertices.data(), context->beginVertices.size());
+	}
+
+	context->beginMode = -1;
+	context->beginVertices.clear();
+}
+
+#pragma region Deferred Draws
+DrawState captureDrawState() {
+	DrawState state;
+	state.texture = drawTexture();
+	state.depthEnabled = context->depthEnabled;
+	state.cullingEnabled = context->cullingEnabled;
+	state.alphaTestEnabled = context->alphaTestEnabled;
+	state.blendEnabled = context->blendEnabled;
+	state.alphaFunc = context->alphaFunc;
+	state.alphaRef = context->alphaRef;
+	state.blendSrc = context->blendSrc;
+	state.blendDst = context->blendDst;
+	state.blendKernel = context->blendKernel;
+	return state;
+}
+
+void applyDrawState(const DrawState& state) {
+	bindDrawTexture(state.texture);
+	context->depthEnabled = state.depthEnabled;
+	context->cullingEnabled = state.cullingEnabled;
+	context->alphaTestEnabled = state.alphaTestEnabled;
+	context->blendEnabled = state.blendEnabled;
+	context->alphaFunc = state.alphaFunc;
+	context->alphaRef = state.alphaRef;
+	context->blendSrc = state.blendSrc;
+	context->blendDst = state.blendDst;
+	context->blendKernel = state.blendKernel;
+}
+
+/*
+Record the transformed batch for the next flush. Draws that depth test without blending give the same
+image in any order (up to coplanar ties) and may be sorted, the rest keep their place.
+*/
+void deferDraw() {
+	if (context->beginVertices.empty()) return;
+
+	std::vector<DrawState>& states = context->deferStates;
+	DrawState state = captureDrawState();
+
+	// Frames switch between a handful of states, the last one is the likely match
+	int index = -1;
+	for (int i = (int)states.size() - 1; i >= 0; i--) {
+		if (states[i] == state) {
+			index = i;
+			break;
+		}
+	}
+
+	if (index == -1) {
+		if (state.texture != nullptr) {
+			std::lock_guard<std::mutex> lock(context->group->mutex);
+			state.texture->refs++;
+		}
+		states.push_back(state);
+		index = (int)states.size() - 1;
+	}
+
+	DeferredDraw draw;
+	draw.state = index;
+	draw.mode = context->beginMode;
+	draw.first = context->deferVertices.size();
+	draw.count = context->beginVertices.size();
+	draw.depth = FLT_MAX;
+	draw.sortable = state.depthEnabled && !state.blendEnabled;
+
+	for (size_t i = 0; i < context->beginVertices.size(); i++) {
+		draw.depth = glm::min(draw.depth, context->beginVertices[i].coord.z);
+	}
+
+	context->deferVertices.insert(context->deferVertices.end(), context->beginVertices.begin(), context->beginVertices.end());
+	context->deferDraws.push_back(draw);
+}
+
+void discardDraws() {
+	if (context->deferStates.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(context->group->mutex);
+		for (size_t i = 0; i < context->deferStates.size(); i++) {
+			unrefTexture(*context->group, context->deferStates[i].texture);
+		}
+	}
+
+	context->deferStates.clear();
+	context->deferDraws.clear();
+	context->deferVertices.clear();
+}
+
+/*
+Rasterize the deferred draws. Every run of sortable draws is ordered by state, so each state is applied
+once per run, and front to back within a state so the early depth test rejects as much as it can.
+*/
+void flushDraws() {
+	if (context->deferDraws.empty()) return;
+
+	const std::vector<DeferredDraw>& draws = context->deferDraws;
+	std::vector<int>& order = context->deferOrder;
+	DrawState current = captureDrawState();
+	int applied = -1;
+
+	size_t first = 0;
+	while (first < draws.size()) {
+		size_t end = first + 1;
+		if (draws[first].sortable) {
+			while (end < draws.size() && draws[end].sortable) end++;
+		}
+
+		order.clear();
+		for (size_t i = first; i < end; i++) {
+			order.push_back((int)i);
+		}
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			if (draws[a].state != draws[b].state) return draws[a].state < draws[b].state;
+			if (draws[a].depth != draws[b].depth) return draws[a].depth < draws[b].depth;
+			return a < b;
+		});
+
+		for (size_t i = 0; i < order.size(); i++) {
+			const DeferredDraw& draw = draws[order[i]];
+			if (draw.state != applied) {
+				applyDrawState(context->deferStates[draw.state]);
+				applied = draw.state;
+			}
+			rasterize(draw.mode, &context->deferVertices[draw.first], draw.count);
+		}
+
+		first = end;
+	}
+
+	applyDrawState(current);
+	discardDraws();
+}
+#pragma endregion
+
+void glColor4f(float r, float g, float b, float a) {
+	if (recordCommand(CMD_COLOR, r, g, b, a)) return;
+
+	context->beginColor = Pixel(r, g, b, a);
+}
+
+void glColor3f(float r, float g, float b) {
+	if (recordCommand(CMD_COLOR, r, g, b, 1.0f)) return;
+
+	context->beginColor = Pixel(r, g, b, 1.0f);
+}
+
+void glTexCoord2f(float u, float v) {
+	if (recordCommand(CMD_TEX_COORD, u, v)) return;
+
+	context->beginTexCoord.x = u;
+	context->beginTexCoord.y = v;
+}
+
+void glVertex3f(float x, float y, float z) {
+	if (recordCommand(CMD_VERTEX, x, y, z)) return;
+
+	if (context->beginMode == -1) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	context->beginVertices.push_back(Vertex(glm::vec3(x, y, z), context->beginTexCoord, context->beginColor));
+}
+
+void glVertex2f(float x, float y) {
+	if (recordCommand(CMD_VERTEX, x, y, 1.0f)) return;
+
+	if (context->beginMode == -1) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	context->beginVertices.push_back(Vertex(glm::vec3(x, y, 1.0), context->beginTexCoord, context->beginColor));
+}
+
+void glMatrixMode(int mode) {
+	if (recordCommand(CMD_MATRIX_MODE, mode)) return;
+
+	GL_BEGIN_CHECK;
+
+	switch (mode) {
+	case GL_MODELVIEW:
+		context->curMatrix = &context->matModelView;
+		break;
+	case GL_PROJECTION:
+		context->curMatrix = &context->matProj;
+		break;
+	default:
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+}
+
+void glLoadIdentity() {
+	if (recordCommand(CMD_LOAD_IDENTITY)) return;
+
+	GL_BEGIN_CHECK;
+
+	*context->curMatrix = glm::mat4(1.0f);
+}
+
+void glTranslatef(float x, float y, float z) {
+	if (recordCommand(CMD_TRANSLATE, x, y, z)) return;
+
+	GL_BEGIN_CHECK;
+	
+	*context->curMatrix = glm::translate(*context->curMatrix, glm::vec3(x, y, z));
+}
+
+void glScalef(float x, float y, float z) {
+	if (recordCommand(CMD_SCALE, x, y, z)) return;
+
+	GL_BEGIN_CHECK;
+
+	*context->curMatrix = glm::scale(*context->curMatrix, glm::vec3(x, y, z));
+}
+
+void glRotatef(float angle, float x, float y, float z) {
+	if (recordCommand(CMD_ROTATE, angle, x, y, z)) return;
+
+	GL_BEGIN_CHECK;
+
+	*context->curMatrix = glm::rotate(*context->curMatrix, angle, glm::vec3(x, y, z));
+}
+
+void glPerspective(float fovy, float aspect, float near, float far) {
+	if (recordCommand(CMD_PERSPECTIVE, fovy, aspect, near, far)) return;
+
+	*context->curMatrix = glm::perspective(fovy, aspect, near, far);
+}
+
+void glLookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ) {	
+	if (recording()) {
+		CommandRing& ring = *context->commands;
+		ring.reserve(3);
+		ring.write(CMD_LOOK_AT, eyeX, eyeY, eyeZ, centerX);
+		ring.write(CMD_ARGS, centerY, centerZ, upX, upY);
+		ring.write(CMD_ARGS, upZ);
+		ring.publish();
+		return;
+	}
+
+	*context->curMatrix = glm::lookAt(glm::vec3(eyeX, eyeY, eyeZ), glm::vec3(centerX, centerY, centerZ), glm::vec3(upX, upY, upZ));
+}
+
+void glGenTextures(int count, int* buf) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	if (count < 0) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	for (int i = 0; i < count; ++i) {
+		int id = group.textures.create();
+		if (id == 0) {
+			context->err = GL_OUT_OF_MEMORY;
+			return;
+		}
+		*group.textures.get(id) = new Texture();
+		buf[i] = id;
+	}
+}
+
+void releaseTexels(Texture& texture) {
+	if (texture.texels != nullptr) {
+		ShareGroup& group = *context->group;
+		std::lock_guard<std::mutex> lock(group.mutex);
+		group.texelPool.release(texture.texels, texture.sizeClass);
+		group.texelGeneration++;
+		texture.texels = nullptr;
+	}
+	texture.w = 0;
+	texture.h = 0;
+}
+
+void glDeleteTextures(int count, const int* buf) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (count < 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	for (int i = 0; i < count; ++i) {
+		// Unknown and stale names are silently ignored, like 0
+		Texture** texture = group.textures.get(buf[i]);
+		if (texture == nullptr) continue;
+
+		// Binds in other contexts keep the texels alive
+		if (context->curTexture == *texture) {
+			unrefTexture(group, context->curTexture);
+			context->curTexture = nullptr;
+		}
+		unrefTexture(group, *texture);
+		group.textures.destroy(buf[i]);
+	}
+}
+
+void glBindTexture(int target, int id) {
+	if (recordCommand(CMD_BIND_TEXTURE, target, id)) return;
+
+	GL_BEGIN_CHECK;
+
+	if (target != GL_TEXTURE_2D) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	Texture* texture = nullptr;
+	if (id != 0) {
+		Texture** object = group.textures.get(id);
+		if (object == nullptr) {
+			context->err = GL_INVALID_OPERATION;
+			return;
+		}
+		texture = *object;
+		texture->refs++;
+	}
+
+	unrefTexture(group, context->curTexture);
+	context->curTexture = texture;
+}
+
+Texture* beginTexImage(int target, int width, int height) {
+	if (target != GL_TEXTURE_2D) {
+		context->err = GL_INVALID_ENUM;
+		return nullptr;
+	}
+
+	if (width <= 0 || height <= 0) {
+		context->err = GL_INVALID_VALUE;
+		return nullptr;
+	}
+
+	if (context->curTexture == nullptr) {
+		context->err = GL_INVALID_OPERATION;
+	}
+	return context->curTexture;
+}
+
+/*
+Size in bytes of the internal texel storage of the given format
+*/
+size_t texelsSize(int format, int width, int height) {
+	switch (format) {
+	case GL_RGBA: return sizeof(Pixel) * width * height;
+	case GL_RGBA8: return (size_t)4 * width * height;
+	case GL_COLOR_INDEX8_EXT: return (size_t)width * height;
+	case GL_COLOR_INDEX4_EXT: return (size_t)((width + 1) / 2) * height;
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+	default: return 0;
+	}
+}
+
+/*
+Replace the texels of the texture with uninitialized storage of the given format
+*/
+void* defineTexels(Texture& texture, int format, int width, int height) {
+	releaseTexels(texture);
+	texture.w = width;
+	texture.h = height;
+	texture.format = format;
+
+	std::lock_guard<std::mutex> lock(context->group->mutex);
+	texture.texels = context->group->texelPool.alloc(texelsSize(format, width, height), texture.sizeClass);
+	return texture.texels;
+}
+
+void glTexImage2D(int target, int width, int height, int type, void* data) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (type != GL_BYTE && type != GL_FLOAT && type != GL_COLOR_INDEX8_EXT && type != GL_COLOR_INDEX4_EXT) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	Texture* texture = beginTexImage(target, width, height);
+	if (texture == nullptr) return;
+
+	// Bytes and indices are kept as uploaded, the sampler expands them
+	if (type != GL_FLOAT) {
+		int format = type == GL_BYTE ? GL_RGBA8 : type;
+		memcpy(defineTexels(*texture, format, width, height), data, texelsSize(format, width, height));
+		return;
+	}
+
+	Pixel* pixels = (Pixel*)defineTexels(*texture, GL_RGBA, width, height);
+	float* arr = (float*)data;
+	int size = width * height;
+	for (int i = 0; i < size; ++i) {
+		pixels[i] = Pixel(	arr[i * 4 + 0],
+							arr[i * 4 + 1],
+							arr[i * 4 + 2],
+							arr[i * 4 + 3]);
+	}
+}
+
+void glCompressedTexImage2D(int target, int width, int height, int format, int imageSize, const void* data) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && format != GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	Texture* texture = beginTexImage(target, width, height);
+	if (texture == nullptr) return;
+
+	if ((size_t)imageSize != texelsSize(format, width, height)) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	memcpy(defineTexels(*texture, format, width, height), data, imageSize);
+}
+
+void setPalette(Texture& texture, int width, int type, const void* data) {
+	if (texture.palette == nullptr) {
+		std::lock_guard<std::mutex> lock(context->group->mutex);
+		texture.palette = (Pixel*)context->group->texelPool.alloc(sizeof(Pixel) * 256, texture.paletteClass);
+	}
+
+	// Entries past the end of the table read as opaque black
+	for (int i = 0; i < 256; i++) {
+		if (i >= width) {
+			texture.palette[i] = Pixel();
+		}
+		else if (type == GL_BYTE) {
+			const unsigned char* arr = (const unsigned char*)data;
+			texture.palette[i] = Pixel(arr[i * 4 + 0], arr[i * 4 + 1], arr[i * 4 + 2], arr[i * 4 + 3]);
+		}
+		else {
+			const float* arr = (const float*)data;
+			texture.palette[i] = Pixel(arr[i * 4 + 0], arr[i * 4 + 1], arr[i * 4 + 2], arr[i * 4 + 3]);
+		}
+	}
+}
+
+void glColorTable(int target, int width, int type, const void* data) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (target != GL_TEXTURE_2D || (type != GL_BYTE && type != GL_FLOAT)) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	if (width <= 0 || width > 256) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	Texture* texture = context->curTexture;
+	if (texture == nullptr) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	setPalette(*texture, width, type, data);
+}
+
+#pragma region Texture Files
+/*
+Read only view of a whole file, the pages are faulted in as the upload touches them
+*/
+struct MappedFile {
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	MappedFile()
+		:	data(nullptr),
+			size(0)
+#ifdef _WIN32
+			, file(INVALID_HANDLE_VALUE),
+			mapping(NULL)
+#endif
+	{
+
+	}
+
+	bool open(const char* path) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return false;
+		size = (size_t)fileSize.QuadPart;
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) return false;
+
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		return data != nullptr;
+#else
+		int fd = ::open(path, O_RDONLY);
+		if (fd == -1) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		size = (size_t)st.st_size;
+
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED) return false;
+
+		madvise(view, size, MADV_SEQUENTIAL);
+		data = (const unsigned char*)view;
+		return true;
+#endif
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data != nullptr) munmap((void*)data, size);
+#endif
+	}
+};
+
+unsigned int readU32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+unsigned short readU16(const unsigned char* p) {
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+bool loadCglt(Texture& texture, const MappedFile& file) {
+	const size_t HEADER_SIZE = 24;
+	if (file.size < HEADER_SIZE) return false;
+
+	unsigned int width = readU32(file.data + 4);
+	unsigned int height = readU32(file.data + 8);
+	int format = (int)readU32(file.data + 12);
+	unsigned int paletteSize = readU32(file.data + 16);
+	unsigned int dataSize = readU32(file.data + 20);
+
+	if (width == 0 || height == 0 || width > 0x8000 || height > 0x8000 || paletteSize > 256) return false;
+
+	size_t size = format == GL_RGBA ? 0 : texelsSize(format, width, height);
+	if (size == 0 || dataSize != size) return false;
+	if (file.size < HEADER_SIZE + paletteSize * 4 + (size_t)dataSize) return false;
+
+	const unsigned char* palette = file.data + HEADER_SIZE;
+	if (paletteSize > 0) {
+		setPalette(texture, paletteSize, GL_BYTE, palette);
+	}
+
+	memcpy(defineTexels(texture, format, width, height), palette + paletteSize * 4, size);
+	return true;
+}
+
+const unsigned char* ppmToken(const unsigned char* p, const unsigned char* end, unsigned int& value) {
+	while (p < end) {
+		if (*p == '#') {
+			while (p < end && *p != '\n') p++;
+		}
+		else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+			p++;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (p == end || *p < '0' || *p > '9') return nullptr;
+
+	value = 0;
+	while (p < end && *p >= '0' && *p <= '9' && value < 0x100000) {
+		value = value * 10 + (*p++ - '0');
+	}
+	return p;
+}
+
+bool loadPpm(Texture& texture, const MappedFile& file) {
+	const unsigned char* end = file.data + file.size;
+	unsigned int width, height, maxValue;
+
+	const unsigned char* p = file.data + 2;
+	if ((p = ppmToken(p, end, width)) == nullptr) return false;
+	if ((p = ppmToken(p, end, height)) == nullptr) return false;
+	if ((p = ppmToken(p, end, maxValue)) == nullptr) return false;
+	p++; // single whitespace before the raster
+
+	if (width == 0 || height == 0 || width > 0x8000 || height > 0x8000 || maxValue != 255) return false;
+	if (p > end || (size_t)(end - p) < (size_t)width * height * 3) return false;
+
+	unsigned char* texels = (unsigned char*)defineTexels(texture, GL_RGBA8, width, height);
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++) {
+		texels[i * 4 + 0] = p[i * 3 + 0];
+		texels[i * 4 + 1] = p[i * 3 + 1];
+		texels[i * 4 + 2] = p[i * 3 + 2];
+		texels[i * 4 + 3] = 0xFF;
+	}
+	return true;
+}
+
+bool loadTga(Texture& texture, const MappedFile& file) {
+	const size_t HEADER_SIZE = 18;
+	if (file.size < HEADER_SIZE) return false;
+
+	const unsigned char* header = file.data;
+	int imageType = header[2];
+	int width = readU16(header + 12);
+	int height = readU16(header + 14);
+	int bytesPerPixel = header[16] / 8;
+	bool topDown = (header[17] & 0x20) != 0;
+
+	if ((imageType != 2 && imageType != 10) || (bytesPerPixel != 3 && bytesPerPixel != 4) || width == 0 || height == 0) return false;
+
+	// skip the image id and the (unused for true color) color map
+	size_t offset = HEADER_SIZE + header[0] + readU16(header + 5) * ((header[7] + 7) / 8);
+	if (offset > file.size) return false;
+
+	const unsigned char* p = file.data + offset;
+	const unsigned char* end = file.data + file.size;
+	if (imageType == 2 && (size_t)(end - p) < (size_t)width * height * bytesPerPixel) return false;
+
+	// Walk the packets of an RLE image first, a truncated one must fail before the texture is replaced
+	if (imageType == 10) {
+		const unsigned char* packet = p;
+		for (size_t left = (size_t)width * height; left > 0;) {
+			if (packet >= end) return false;
+			bool repeatPacket = (*packet & 0x80) != 0;
+			size_t count = glm::min((size_t)(*packet++ & 0x7F) + 1, left);
+			size_t bytes = repeatPacket ? bytesPerPixel : count * bytesPerPixel;
+			if ((size_t)(end - packet) < bytes) return false;
+			packet += bytes;
+			left -= count;
+		}
+	}
+
+	unsigned char* texels = (unsigned char*)defineTexels(texture, GL_RGBA8, width, height);
+
+	int run = 0;
+	bool repeat = false;
+	for (int y = 0; y < height; y++) {
+		unsigned char* row = texels + (size_t)(topDown ? y : height - 1 - y) * width * 4;
+		for (int x = 0; x < width; x++) {
+			if (imageType == 10 && run == 0) {
+				repeat = (*p & 0x80) != 0;
+				run = (*p++ & 0x7F) + 1;
+			}
+
+			row[x * 4 + 0] = p[2];
+			row[x * 4 + 1] = p[1];
+			row[x * 4 + 2] = p[0];
+			row[x * 4 + 3] = bytesPerPixel == 4 ? p[3] : 0xFF;
+
+			if (imageType == 2 || !repeat || run == 1) p += bytesPerPixel;
+			if (imageType == 10) run--;
+		}
+	}
+	return true;
+}
+
+void glTexImage2DFileEXT(int target, const char* path) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (target != GL_TEXTURE_2D) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	Texture* texture = context->curTexture;
+	if (texture == nullptr) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	MappedFile file;
+	if (!file.open(path)) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	bool loaded;
+	if (file.size >= 4 && memcmp(file.data, "CGLT", 4) == 0) {
+		loaded = loadCglt(*texture, file);
+	}
+	else if (file.size >= 2 && file.data[0] == 'P' && file.data[1] == '6') {
+		loaded = loadPpm(*texture, file);
+	}
+	else {
+		loaded = loadTga(*texture, file);
+	}
+
+	if (!loaded) {
+		context->err = GL_INVALID_VALUE;
+	}
+}
+#pragma endregion
+
+#pragma region OLC
+// this was taken from the webcam to console:
+// https://github.com/OneLoneCoder/videos/blob/master/OneLoneCoder_Webcam.cpp
+
+enum COLOUR
+{
+	FG_BLACK = 0x0000,
+	FG_DARK_BLUE = 0x0001,
+	FG_DARK_GREEN = 0x0002,
+	FG_DARK_CYAN = 0x0003,
+	FG_DARK_RED = 0x0004,
+	FG_DARK_MAGENTA = 0x0005,
+	FG_DARK_YELLOW = 0x0006,
+	FG_GREY = 0x0007, // Thanks MS :-/
+	FG_DARK_GREY = 0x0008,
+	FG_BLUE = 0x0009,
+	FG_GREEN = 0x000A,
+	FG_CYAN = 0x000B,
+	FG_RED = 0x000C,
+	FG_MAGENTA = 0x000D,
+	FG_YELLOW = 0x000E,
+	FG_WHITE = 0x000F,
+	BG_BLACK = 0x0000,
+	BG_DARK_BLUE = 0x0010,
+	BG_DARK_GREEN = 0x0020,
+	BG_DARK_CYAN = 0x0030,
+	BG_DARK_RED = 0x0040,
+	BG_DARK_MAGENTA = 0x0050,
+	BG_DARK_YELLOW = 0x0060,
+	BG_GREY = 0x0070,
+	BG_DARK_GREY = 0x0080,
+	BG_BLUE = 0x0090,
+	BG_GREEN = 0x00A0,
+	BG_CYAN = 0x00B0,
+	BG_RED = 0x00C0,
+	BG_MAGENTA = 0x00D0,
+	BG_YELLOW = 0x00E0,
+	BG_WHITE = 0x00F0,
+};
+
+enum PIXEL_TYPE
+{
+	PIXEL_SOLID = 0x2588,
+	PIXEL_THREEQUARTERS = 0x2593,
+	PIXEL_HALF = 0x2592,
+	PIXEL_QUARTER = 0x2591,
+};
+
+typedef struct
+{
+	float r;       // a fraction between 0 and 1
+	float g;       // a fraction between 0 and 1
+	float b;       // a fraction between 0 and 1
+} rgb;
+
+typedef struct
+{
+	float h;       // angle in degrees
+	float s;       // a fraction between 0 and 1
+	float v;       // a fraction between 0 and 1
+} hsv;
+
+hsv rgb2hsv(rgb in)
+{
+	hsv         out;
+	float      min, max, delta;
+
+	min = in.r < in.g ? in.r : in.g;
+	min = min  < in.b ? min : in.b;
+
+	max = in.r > in.g ? in.r : in.g;
+	max = max  > in.b ? max : in.b;
+
+	out.v = max;                                // v
+	delta = max - min;
+	if (delta < 0.00001f)
+	{
+		out.s = 0;
+		out.h = 0; // undefined, maybe nan?
+		return out;
+	}
+	if (max > 0.0) { // NOTE: if Max is == 0, this divide would cause a crash
+		out.s = (delta / max);                  // s
+	}
+	else {
+		// if max is 0, then r = g = b = 0              
+		// s = 0, h is undefined
+		out.s = 0.0;
+		out.h = NAN;                            // its now undefined
+		return out;
+	}
+	if (in.r >= max)                           // > is bogus, just keeps compilor happy
+		out.h = (in.g - in.b) / delta;        // between yellow & magenta
+	else
+		if (in.g >= max)
+			out.h = 2.0 + (in.b - in.r) / delta;  // between cyan & yellow
+		else
+			out.h = 4.0 + (in.r - in.g) / delta;  // between magenta & cyan
+
+	out.h *= 60.0;                              // degrees
+
+	if (out.h < 0.0)
+		out.h += 360.0;
+
+	return out;
+}
+
+struct OlcCell {
+	wchar_t c;
+	short col;
+};
+
+#define OLC_HUE_CELLS			(24)
+#define OLC_GREY_CELLS			(13)
+
+// The hue cells followed by the grey levels, a console cell is an index into this
+const OlcCell olcCells[OLC_HUE_CELLS + OLC_GREY_CELLS] =
+{
+	{ PIXEL_SOLID,				FG_RED | BG_RED },
+	{ PIXEL_QUARTER,			FG_YELLOW | BG_RED },
+	{ PIXEL_HALF,				FG_YELLOW | BG_RED },
+	{ PIXEL_THREEQUARTERS,		FG_YELLOW | BG_RED },
+
+	{ PIXEL_SOLID,				FG_GREEN | BG_YELLOW },
+	{ PIXEL_QUARTER,			FG_GREEN | BG_YELLOW },
+	{ PIXEL_HALF,				FG_GREEN | BG_YELLOW },
+	{ PIXEL_THREEQUARTERS,		FG_GREEN | BG_YELLOW },
+
+	{ PIXEL_SOLID,				FG_CYAN | BG_GREEN },
+	{ PIXEL_QUARTER,			FG_CYAN | BG_GREEN },
+	{ PIXEL_HALF,				FG_CYAN | BG_GREEN },
+	{ PIXEL_THREEQUARTERS,		FG_CYAN | BG_GREEN },
+
+	{ PIXEL_SOLID,				FG_BLUE | BG_CYAN },
+	{ PIXEL_QUARTER,			FG_BLUE | BG_CYAN },
+	{ PIXEL_HALF,				FG_BLUE | BG_CYAN },
+	{ PIXEL_THREEQUARTERS,		FG_BLUE | BG_CYAN },
+
+	{ PIXEL_SOLID,				FG_MAGENTA | BG_BLUE },
+	{ PIXEL_QUARTER,			FG_MAGENTA | BG_BLUE },
+	{ PIXEL_HALF,				FG_MAGENTA | BG_BLUE },
+	{ PIXEL_THREEQUARTERS,		FG_MAGENTA | BG_BLUE },
+
+	{ PIXEL_SOLID,				FG_RED | BG_MAGENTA },
+	{ PIXEL_QUARTER,			FG_RED | BG_MAGENTA },
+	{ PIXEL_HALF,				FG_RED | BG_MAGENTA },
+	{ PIXEL_THREEQUARTERS,		FG_RED | BG_MAGENTA },
+
+	{ PIXEL_SOLID,				BG_BLACK | FG_BLACK },
+
+	{ PIXEL_QUARTER,			BG_BLACK | FG_DARK_GREY },
+	{ PIXEL_HALF,				BG_BLACK | FG_DARK_GREY },
+	{ PIXEL_THREEQUARTERS,		BG_BLACK | FG_DARK_GREY },
+	{ PIXEL_SOLID,				BG_BLACK | FG_DARK_GREY },
+
+	{ PIXEL_QUARTER,			BG_DARK_GREY | FG_GREY },
+	{ PIXEL_HALF,				BG_DARK_GREY | FG_GREY },
+	{ PIXEL_THREEQUARTERS,		BG_DARK_GREY | FG_GREY },
+	{ PIXEL_SOLID,				BG_DARK_GREY | FG_GREY },
+
+	{ PIXEL_QUARTER,			BG_GREY | FG_WHITE },
+	{ PIXEL_HALF,				BG_GREY | FG_WHITE },
+	{ PIXEL_THREEQUARTERS,		BG_GREY | FG_WHITE },
+	{ PIXEL_SOLID,				BG_GREY | FG_WHITE },
+};
+
+int ClassifyPixel_Grey(float r, float g, float b)
+{
+	float luminance = 0.2987f * r + 0.5870f * g + 0.1140f * b;
+	int pixel_bw = (int)(luminance * 13.0f);
+	return OLC_HUE_CELLS + glm::clamp(pixel_bw, 0, OLC_GREY_CELLS - 1);
+}
+
+int ClassifyPixel_HSL(float r, float g, float b)
+{
+	hsv col = rgb2hsv({ r, g, b });
+
+	if (col.s > 0.2f)
+		return glm::min((int)((col.h / 360.0f) * 24.0f), OLC_HUE_CELLS - 1);
+	else
+		return ClassifyPixel_Grey(r, g, b);
+}
+
+/*
+RGB to console cell lookup, 5 bits per channel. Every bin holds the exact classification of its
+center, so the per pixel HSV conversion becomes a gather. EXT_OLC_SLOW_COLOR goes back to the
+exact classification.
+*/
+#define OLC_LUT_BITS			(5)
+#define OLC_LUT_SIZE			(1 << OLC_LUT_BITS)
+
+unsigned char olcCellLut[OLC_LUT_SIZE * OLC_LUT_SIZE * OLC_LUT_SIZE];
+std::once_flag olcCellLutOnce;
+
+void buildOlcCellLut() {
+	for (int r = 0; r < OLC_LUT_SIZE; r++) {
+		for (int g = 0; g < OLC_LUT_SIZE; g++) {
+			for (int b = 0; b < OLC_LUT_SIZE; b++) {
+				int index = (r << (OLC_LUT_BITS * 2)) | (g << OLC_LUT_BITS) | b;
+				olcCellLut[index] = (unsigned char)ClassifyPixel_HSL((r + 0.5f) / OLC_LUT_SIZE, (g + 0.5f) / OLC_LUT_SIZE, (b + 0.5f) / OLC_LUT_SIZE);
+			}
+		}
+	}
+}
+
+void initOlcCellLut() {
+	std::call_once(olcCellLutOnce, buildOlcCellLut);
+}
+
+#ifdef GL_SSE
+int olcLutIndex(const Pixel& p) {
+	// Bins of the a, b, g, r lanes, then a weighted sum of the b, g, r bins
+	__m128 v = _mm_mul_ps(_mm_loadu_ps(&p.a), _mm_set1_ps((float)OLC_LUT_SIZE));
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps((float)(OLC_LUT_SIZE - 1)));
+	__m128i bins = _mm_cvttps_epi32(v);
+	__m128i sums = _mm_madd_epi16(_mm_packs_epi32(bins, bins), _mm_setr_epi16(0, 1, OLC_LUT_SIZE, OLC_LUT_SIZE * OLC_LUT_SIZE, 0, 0, 0, 0));
+	return _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+#else
+int olcLutBin(float v) {
+	return glm::min((int)(GL_CLAMP(v) * OLC_LUT_SIZE), OLC_LUT_SIZE - 1);
+}
+
+int olcLutIndex(const Pixel& p) {
+	return (olcLutBin(p.r) << (OLC_LUT_BITS * 2)) | (olcLutBin(p.g) << OLC_LUT_BITS) | olcLutBin(p.b);
+}
+#endif
+
+int classifyCell(const Pixel& p) {
+	if (context->extOlcSlowColor) {
+		return ClassifyPixel_HSL(GL_CLAMP(p.r), GL_CLAMP(p.g), GL_CLAMP(p.b));
+	}
+
+	return olcCellLut[olcLutIndex(p)];
+}
+
+// The console palette and how much of a cell the glyph covers with the foreground color
+const unsigned char olcPalette[16][3] =
+{
+	{ 0, 0, 0 }, { 0, 0, 128 }, { 0, 128, 0 }, { 0, 128, 128 }, { 128, 0, 0 }, { 128, 0, 128 }, { 128, 128, 0 }, { 192, 192, 192 },
+	{ 128, 128, 128 }, { 0, 0, 255 }, { 0, 255, 0 }, { 0, 255, 255 }, { 255, 0, 0 }, { 255, 0, 255 }, { 255, 255, 0 }, { 255, 255, 255 },
+};
+
+float olcGlyphCoverage(wchar_t c) {
+	switch (c) {
+	case PIXEL_QUARTER: return 0.25f;
+	case PIXEL_HALF: return 0.5f;
+	case PIXEL_THREEQUARTERS: return 0.75f;
+	default: return 1.0f;
+	}
+}
+
+ColorOlcCell::Storage ColorOlcCell::encode(const Pixel& p) {
+	return (Storage)classifyCell(p);
+}
+
+Pixel ColorOlcCell::decode(Storage s) {
+	const OlcCell& cell = olcCells[s];
+	const unsigned char* fg = olcPalette[cell.col & 0xF];
+	const unsigned char* bg = olcPalette[(cell.col >> 4) & 0xF];
+	float coverage = olcGlyphCoverage(cell.c);
+
+	return Pixel(
+		(fg[0] * coverage + bg[0] * (1.0f - coverage)) / 255.0f,
+		(fg[1] * coverage + bg[1] * (1.0f - coverage)) / 255.0f,
+		(fg[2] * coverage + bg[2] * (1.0f - coverage)) / 255.0f,
+		1.0f);
+}
+
+/*
+EXT_OLC_PIXEL_DITHERED quantizes to every color a cell can show, the 16 solid colors and each pair
+of them through the quarter, half and three quarter shades. The nearest cell of every 5 bit per
+channel color is a table, the pixel's Bayer threshold is added to its color before the lookup so
+no pixel depends on another.
+*/
+#define OLC_DITHER_CELLS		(16 + 16 * 15 / 2 * 3)
+
+OlcCell olcDitherCells[OLC_DITHER_CELLS];
+unsigned short olcDitherLut[OLC_LUT_SIZE * OLC_LUT_SIZE * OLC_LUT_SIZE];
+std::once_flag olcDitherLutOnce;
+
+// 4x4 Bayer matrix as color offsets, 2 * b - 15 spreads the thresholds over 32 levels, about the spacing of the cell colors
+const int olcBayer[4][4] =
+{
+	{ -15, 1, -11, 5 },
+	{ 9, -7, 13, -3 },
+	{ -9, 7, -13, 3 },
+	{ 15, -1, 11, -5 },
+};
+
+void buildOlcDitherLut() {
+	// A quarter shade of one color over another is the three quarter shade of the other way around
+	const wchar_t shades[3] = { PIXEL_QUARTER, PIXEL_HALF, PIXEL_THREEQUARTERS };
+	int count = 0;
+	for (int i = 0; i < 16; i++) {
+		olcDitherCells[count++] = { PIXEL_SOLID, (short)(i | (i << 4)) };
+	}
+	for (int bg = 0; bg < 16; bg++) {
+		for (int fg = bg + 1; fg < 16; fg++) {
+			for (wchar_t shade : shades) {
+				olcDitherCells[count++] = { shade, (short)(fg | (bg << 4)) };
+			}
+		}
+	}
+
+	float colors[OLC_DITHER_CELLS][3];
+	for (int i = 0; i < OLC_DITHER_CELLS; i++) {
+		const unsigned char* fg = olcPalette[olcDitherCells[i].col & 0xF];
+		const unsigned char* bg = olcPalette[(olcDitherCells[i].col >> 4) & 0xF];
+		float coverage = olcGlyphCoverage(olcDitherCells[i].c);
+		for (int c = 0; c < 3; c++) {
+			colors[i][c] = fg[c] * coverage + bg[c] * (1.0f - coverage);
+		}
+	}
+
+	for (int index = 0; index < OLC_LUT_SIZE * OLC_LUT_SIZE * OLC_LUT_SIZE; index++) {
+		float r = (float)(((index >> (OLC_LUT_BITS * 2)) << (8 - OLC_LUT_BITS)) | 4);
+		float g = (float)((((index >> OLC_LUT_BITS) & (OLC_LUT_SIZE - 1)) << (8 - OLC_LUT_BITS)) | 4);
+		float b = (float)(((index & (OLC_LUT_SIZE - 1)) << (8 - OLC_LUT_BITS)) | 4);
+
+		int best = 0;
+		float bestDist = FLT_MAX;
+		for (int i = 0; i < OLC_DITHER_CELLS; i++) {
+			float dr = r - colors[i][0];
+			float dg = g - colors[i][1];
+			float db = b - colors[i][2];
+			float dist = dr * dr + dg * dg + db * db;
+			if (dist < bestDist) {
+				bestDist = dist;
+				best = i;
+			}
+		}
+		olcDitherLut[index] = (unsigned short)best;
+	}
+}
+
+void initOlcDitherLut() {
+	std::call_once(olcDitherLutOnce, buildOlcDitherLut);
+}
+#pragma endregion
+
+#pragma region Readback
+template<class F, typename T>
+void encodeClear(unsigned char* out, const T& value) {
+	typename F::Storage encoded = F::encode(value);
+	memcpy(out, &encoded, sizeof(encoded));
+}
+
+FramebufferView makeFramebufferView() {
+	FramebufferView view;
+	view.w = context->w;
+	view.h = context->h;
+	view.colorFormat = context->colorFormat;
+	view.depthFormat = context->depthFormat;
+	view.color = context->bufColor;
+	view.depth = context->bufDepth;
+	view.tileFlags = context->tileFlags.data();
+	view.tilesX = context->tilesX;
+	view.slowColor = context->extOlcSlowColor;
+	view.dirtyOnly = false;
+
+	switch (context->colorFormat) {
+	case GL_RGBA8: encodeClear<ColorRGBA8>(view.colorClear, context->tileColorClear); break;
+	case GL_RGB565: encodeClear<ColorRGB565>(view.colorClear, context->tileColorClear); break;
+	case EXT_OLC_PIXEL_FORMAT: encodeClear<ColorOlcCell>(view.colorClear, context->tileColorClear); break;
+	default: encodeClear<ColorRGBA32F>(view.colorClear, context->tileColorClear); break;
+	}
+
+	switch (context->depthFormat) {
+	case GL_DEPTH_COMPONENT16: encodeClear<DepthU16>(view.depthClear, context->tileDepthClear); break;
+	case GL_DEPTH_COMPONENT24: encodeClear<DepthU24>(view.depthClear, context->tileDepthClear); break;
+	default: encodeClear<DepthF32>(view.depthClear, context->tileDepthClear); break;
+	}
+
+	return view;
+}
+
+/*
+Walk the region as row spans of at most one tile. Spans of tiles with a pending clear get a
+source row made of the clear value instead of the (stale) buffer contents. fn gets the client
+row and the column of the span within the region. Clean tiles are skipped for dirty only views.
+*/
+template<class F, typename Fn>
+void forEachSpan(const FramebufferView& view, const void* buf, unsigned char clearFlag, const unsigned char* clearValue, const ReadRegion& region, Fn fn) {
+	typename F::Storage clear;
+	memcpy(&clear, clearValue, sizeof(clear));
+
+	typename F::Storage clearRow[GL_TILE_SIZE];
+	std::fill(clearRow, clearRow + GL_TILE_SIZE, clear);
+
+	for (int y = region.y; y < region.y + region.h; y++) {
+		const unsigned char* flags = view.tileFlags + (y >> GL_TILE_SHIFT) * view.tilesX;
+		const typename F::Storage* row = (const typename F::Storage*)buf + (size_t)y * view.w;
+		unsigned char* out = region.data + (size_t)(y - region.y) * region.stride;
+
+		for (int x = region.x; x < region.x + region.w;) {
+			int count = glm::min(((x >> GL_TILE_SHIFT) + 1) << GL_TILE_SHIFT, region.x + region.w) - x;
+			unsigned char tile = flags[x >> GL_TILE_SHIFT];
+			if (!view.dirtyOnly || (tile & GL_TILE_DIRTY)) {
+				const typename F::Storage* src = (tile & clearFlag) ? clearRow : row + x;
+				fn(src, out, x - region.x, count);
+			}
+			x += count;
+		}
+	}
+}
+
+// Pixels to r, g, b, a bytes, four at a time with SSE
+void packRGBA8(const Pixel* src, unsigned char* out, int count) {
+	int i = 0;
+
+#ifdef GL_SSE
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 scale = _mm_set1_ps(255.0f);
+	__m128 half = _mm_set1_ps(0.5f);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i bytes[4];
+		for (int j = 0; j < 4; j++) {
+			__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i + j].a), zero), one);
+			v = _mm_add_ps(_mm_mul_ps(v, scale), half);
+
+			// a, b, g, r lanes to r, g, b, a
+			bytes[j] = _mm_shuffle_epi32(_mm_cvttps_epi32(v), _MM_SHUFFLE(0, 1, 2, 3));
+		}
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(bytes[0], bytes[1]), _mm_packs_epi32(bytes[2], bytes[3]));
+		_mm_storeu_si128((__m128i*)(out + i * 4), packed);
+	}
+#endif
+
+	for (; i < count; i++) {
+		out[i * 4 + 0] = (unsigned char)toUnorm8(src[i].r);
+		out[i * 4 + 1] = (unsigned char)toUnorm8(src[i].g);
+		out[i * 4 + 2] = (unsigned char)toUnorm8(src[i].b);
+		out[i * 4 + 3] = (unsigned char)toUnorm8(src[i].a);
+	}
+}
+
+// At most GL_TILE_SIZE pixels in the client format and type
+void writePixels(const Pixel* src, int count, int format, int type, unsigned char* out) {
+	if (type == GL_BYTE) {
+		if (format == GL_RGBA) {
+			packRGBA8(src, out, count);
+			return;
+		}
+
+		unsigned char rgba[GL_TILE_SIZE * 4];
+		packRGBA8(src, rgba, count);
+		for (int i = 0; i < count; i++) {
+			out[i * 3 + 0] = rgba[i * 4 + 0];
+			out[i * 3 + 1] = rgba[i * 4 + 1];
+			out[i * 3 + 2] = rgba[i * 4 + 2];
+		}
+		return;
+	}
+
+	int channels = format == GL_RGBA ? 4 : 3;
+	for (int i = 0; i < count; i++) {
+		float rgba[4] = { src[i].r, src[i].g, src[i].b, src[i].a };
+		memcpy(out + (size_t)i * channels * sizeof(float), rgba, channels * sizeof(float));
+	}
+}
+
+size_t readPixelSize(int format, int type) {
+	if (format == EXT_OLC_PIXEL_FORMAT) return sizeof(OlcPixel);
+
+	size_t components = format == GL_RGBA ? 4 : (format == GL_RGB ? 3 : 1);
+	return components * (type == GL_FLOAT ? sizeof(float) : 1);
+}
+
+template<class C>
+void readColor(const FramebufferView& view, const ReadRegion& region, int format, int type) {
+	size_t pixelSize = readPixelSize(format, type);
+
+	forEachSpan<C>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const typename C::Storage* src, unsigned char* out, int x, int count) {
+		Pixel pixels[GL_TILE_SIZE];
+		for (int i = 0; i < count; i++) {
+			pixels[i] = C::decode(src[i]);
+		}
+		writePixels(pixels, count, format, type, out + x * pixelSize);
+	});
+}
+
+template<>
+void readColor<ColorRGBA32F>(const FramebufferView& view, const ReadRegion& region, int format, int type) {
+	size_t pixelSize = readPixelSize(format, type);
+
+	forEachSpan<ColorRGBA32F>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const Pixel* src, unsigned char* out, int x, int count) {
+		writePixels(src, count, format, type, out + x * pixelSize);
+	});
+}
+
+// RGBA8 is stored in the GL_RGBA / GL_BYTE layout already
+template<>
+void readColor<ColorRGBA8>(const FramebufferView& view, const ReadRegion& region, int format, int type) {
+	size_t pixelSize = readPixelSize(format, type);
+
+	forEachSpan<ColorRGBA8>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const unsigned int* src, unsigned char* out, int x, int count) {
+		out += x * pixelSize;
+
+		if (type == GL_BYTE && format == GL_RGBA) {
+			memcpy(out, src, (size_t)count * 4);
+		}
+		else if (type == GL_BYTE) {
+			for (int i = 0; i < count; i++) {
+				out[i * 3 + 0] = (unsigned char)src[i];
+				out[i * 3 + 1] = (unsigned char)(src[i] >> 8);
+				out[i * 3 + 2] = (unsigned char)(src[i] >> 16);
+			}
+		}
+		else {
+			Pixel pixels[GL_TILE_SIZE];
+			for (int i = 0; i < count; i++) {
+				pixels[i] = ColorRGBA8::decode(src[i]);
+			}
+			writePixels(pixels, count, format, type, out);
+		}
+	});
+}
+
+template<class D>
+void readDepth(const FramebufferView& view, const ReadRegion& region, int type) {
+	forEachSpan<D>(view, view.depth, GL_TILE_DEPTH_CLEAR, view.depthClear, region, [&](const typename D::Storage* src, unsigned char* out, int x, int count) {
+		for (int i = 0; i < count; i++) {
+			if (type == GL_BYTE) {
+				out[x + i] = (char)(D::decode(src[i]) * 255);
+			}
+			else if (type == GL_FLOAT) {
+				float depth = D::decode(src[i]);
+				memcpy(out + (x + i) * sizeof(float), &depth, sizeof(float));
+			}
+		}
+	});
+}
+
+template<typename G, typename A, typename I>
+void storeCells(const I* cells, const OlcCell* table, int count, unsigned char* out, const OlcCellLayoutEXT& layout) {
+	// Locals, the stores could alias the layout otherwise
+	unsigned char* glyph = out + layout.glyphOffset;
+	unsigned char* attr = out + layout.attrOffset;
+	size_t cellSize = layout.cellSize;
+
+	for (int i = 0; i < count; i++) {
+		const OlcCell& cell = table[cells[i]];
+		G c = (G)cell.c;
+		A col = (A)cell.col;
+		memcpy(glyph + i * cellSize, &c, sizeof(c));
+		memcpy(attr + i * cellSize, &col, sizeof(col));
+	}
+}
+
+// Write cells, indices into table, through a caller described layout
+template<typename I>
+void storeCells(const I* cells, const OlcCell* table, int count, unsigned char* out, const OlcCellLayoutEXT& layout) {
+	if (layout.glyphOffset >= 0 && layout.attrOffset >= 0) {
+		if (layout.glyphSize == 2 && layout.attrSize == 2) storeCells<unsigned short, unsigned short>(cells, table, count, out, layout);
+		else if (layout.glyphSize == 2) storeCells<unsigned short, unsigned char>(cells, table, count, out, layout);
+		else if (layout.attrSize == 2) storeCells<unsigned int, unsigned short>(cells, table, count, out, layout);
+		else storeCells<unsigned int, unsigned char>(cells, table, count, out, layout);
+		return;
+	}
+
+	// Only one of the fields
+	for (int i = 0; i < count; i++) {
+		const OlcCell& cell = table[cells[i]];
+		unsigned int c = (unsigned int)cell.c;
+		unsigned short col = (unsigned short)cell.col;
+		if (layout.glyphOffset >= 0) memcpy(out + layout.glyphOffset, &c, layout.glyphSize);
+		if (layout.attrOffset >= 0) memcpy(out + layout.attrOffset, &col, layout.attrSize);
+		out += layout.cellSize;
+	}
+}
+
+template<class C>
+void readCells(const FramebufferView& view, const ReadRegion& region, const OlcCellLayoutEXT& layout) {
+	forEachSpan<C>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const typename C::Storage* src, unsigned char* out, int x, int count) {
+		unsigned char cells[GL_TILE_SIZE];
+		if (view.slowColor) {
+			for (int i = 0; i < count; i++) {
+				Pixel cValue = C::decode(src[i]);
+				cells[i] = (unsigned char)ClassifyPixel_HSL(cValue.r, cValue.g, cValue.b);
+			}
+		}
+		else {
+			for (int i = 0; i < count; i++) {
+				cells[i] = olcCellLut[olcLutIndex(C::decode(src[i]))];
+			}
+		}
+		storeCells(cells, olcCells, count, out + x * layout.cellSize, layout);
+	});
+}
+
+// The bytes already are the bins, no float conversion
+template<>
+void readCells<ColorRGBA8>(const FramebufferView& view, const ReadRegion& region, const OlcCellLayoutEXT& layout) {
+	int shift = 8 - OLC_LUT_BITS;
+	unsigned int mask = OLC_LUT_SIZE - 1;
+
+	forEachSpan<ColorRGBA8>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const unsigned int* src, unsigned char* out, int x, int count) {
+		unsigned char cells[GL_TILE_SIZE];
+		if (view.slowColor) {
+			for (int i = 0; i < count; i++) {
+				Pixel cValue = ColorRGBA8::decode(src[i]);
+				cells[i] = (unsigned char)ClassifyPixel_HSL(cValue.r, cValue.g, cValue.b);
+			}
+		}
+		else {
+			for (int i = 0; i < count; i++) {
+				unsigned int s = src[i];
+				unsigned int index = (((s >> shift) & mask) << (OLC_LUT_BITS * 2)) | (((s >> (8 + shift)) & mask) << OLC_LUT_BITS) | ((s >> (16 + shift)) & mask);
+				cells[i] = olcCellLut[index];
+			}
+		}
+		storeCells(cells, olcCells, count, out + x * layout.cellSize, layout);
+	});
+}
+
+// The cells are already classified, only the layout is applied
+template<>
+void readCells<ColorOlcCell>(const FramebufferView& view, const ReadRegion& region, const OlcCellLayoutEXT& layout) {
+	forEachSpan<ColorOlcCell>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const unsigned char* src, unsigned char* out, int x, int count) {
+		storeCells(src, olcCells, count, out + x * layout.cellSize, layout);
+	});
+}
+
+template<class C>
+void colorBytes(const typename C::Storage& s, int* rgb) {
+	Pixel p = C::decode(s);
+	rgb[0] = (int)toUnorm8(p.r);
+	rgb[1] = (int)toUnorm8(p.g);
+	rgb[2] = (int)toUnorm8(p.b);
+}
+
+template<>
+void colorBytes<ColorRGBA8>(const unsigned int& s, int* rgb) {
+	rgb[0] = s & 0xFF;
+	rgb[1] = (s >> 8) & 0xFF;
+	rgb[2] = (s >> 16) & 0xFF;
+}
+
+template<class C>
+void readCellsDithered(const FramebufferView& view, const ReadRegion& region, const OlcCellLayoutEXT& layout) {
+	int shift = 8 - OLC_LUT_BITS;
+
+	forEachSpan<C>(view, view.color, GL_TILE_COLOR_CLEAR, view.colorClear, region, [&](const typename C::Storage* src, unsigned char* out, int x, int count) {
+		// The threshold goes by framebuffer position, the row is where the span lands in the client memory
+		const int* threshold = olcBayer[(region.y + (int)((out - region.data) / region.stride)) & 3];
+		int fbX = region.x + x;
+
+		unsigned short cells[GL_TILE_SIZE];
+		for (int i = 0; i < count; i++) {
+			int rgb[3];
+			colorBytes<C>(src[i], rgb);
+			int t = threshold[(fbX + i) & 3];
+			int r = glm::clamp(rgb[0] + t, 0, 255) >> shift;
+			int g = glm::clamp(rgb[1] + t, 0, 255) >> shift;
+			int b = glm::clamp(rgb[2] + t, 0, 255) >> shift;
+			cells[i] = olcDitherLut[(r << (OLC_LUT_BITS * 2)) | (g << OLC_LUT_BITS) | b];
+		}
+		storeCells(cells, olcDitherCells, count, out + x * layout.cellSize, layout);
+	});
+}
+
+void readCells(const FramebufferView& view, const ReadRegion& region, const OlcCellLayoutEXT& layout, bool dither) {
+	// EXT_OLC_PIXEL_FORMAT only has the cells, there is no color left to dither
+	if (dither && view.colorFormat != EXT_OLC_PIXEL_FORMAT) {
+		initOlcDitherLut();
+
+		switch (view.colorFormat) {
+		case GL_RGBA8: readCellsDithered<ColorRGBA8>(view, region, layout); break;
+		case GL_RGB565: readCellsDithered<ColorRGB565>(view, region, layout); break;
+		default: readCellsDithered<ColorRGBA32F>(view, region, layout); break;
+		}
+		return;
+	}
+
+	switch (view.colorFormat) {
+	case GL_RGBA8: readCells<ColorRGBA8>(view, region, layout); break;
+	case GL_RGB565: readCells<ColorRGB565>(view, region, layout); break;
+	case EXT_OLC_PIXEL_FORMAT: readCells<ColorOlcCell>(view, region, layout); break;
+	default: readCells<ColorRGBA32F>(view, region, layout); break;
+	}
+}
+
+// EXT_OLC_PIXEL readback is a cell layout like any other
+const OlcCellLayoutEXT olcPixelLayout = { nullptr, 0, sizeof(OlcPixel), offsetof(OlcPixel, c), sizeof(wchar_t), offsetof(OlcPixel, col), sizeof(unsigned short) };
+
+void readPixels(const FramebufferView& view, const ReadRegion& region, int format, int type) {
+	if (format == GL_RGBA || format == GL_RGB) {
+		switch (view.colorFormat) {
+		case GL_RGBA8: readColor<ColorRGBA8>(view, region, format, type); break;
+		case GL_RGB565: readColor<ColorRGB565>(view, region, format, type); break;
+		case EXT_OLC_PIXEL_FORMAT: readColor<ColorOlcCell>(view, region, format, type); break;
+		default: readColor<ColorRGBA32F>(view, region, format, type); break;
+		}
+	}
+	else if (format == GL_DEPTH_COMPONENT) {
+		switch (view.depthFormat) {
+		case GL_DEPTH_COMPONENT16: readDepth<DepthU16>(view, region, type); break;
+		case GL_DEPTH_COMPONENT24: readDepth<DepthU24>(view, region, type); break;
+		default: readDepth<DepthF32>(view, region, type); break;
+		}
+	}
+	else if (format == EXT_OLC_PIXEL_FORMAT) {
+		readCells(view, region, olcPixelLayout, type == EXT_OLC_PIXEL_DITHERED);
+	}
+}
+
+void ReadbackWorker::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		wake.wait(lock, [&] { return quit || !jobs.empty(); });
+		if (jobs.empty()) return;
+
+		Job& job = jobs.front();
+		lock.unlock();
+		readPixels(job.view, job.region, job.format, job.type);
+		lock.lock();
+
+		spareSnapshots.push_back(std::vector<unsigned char>());
+		spareSnapshots.back().swap(job.snapshot);
+		jobs.pop_front();
+		completed++;
+		done.notify_all();
+	}
+}
+
+/*
+Copy the tile rows covering the region of the color or depth buffer, and their tile flags, into snapshot.
+The returned view reads the copy, its first row is framebuffer row firstRow.
+*/
+FramebufferView snapshotFramebuffer(const ReadRegion& region, bool depth, std::vector<unsigned char>& snapshot, int& firstRow) {
+	FramebufferView view = makeFramebufferView();
+	size_t rowSize = view.w * (depth ? depthFormatSize(view.depthFormat) : colorFormatSize(view.colorFormat));
+	firstRow = (region.y >> GL_TILE_SHIFT) << GL_TILE_SHIFT;
+	int rows = region.y + region.h - firstRow;
+	int firstTile = (firstRow >> GL_TILE_SHIFT) * view.tilesX;
+	int tiles = ((rows + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT) * view.tilesX;
+
+	snapshot.resize(rowSize * rows + tiles);
+
+	const unsigned char* src = (const unsigned char*)(depth ? view.depth : view.color);
+	memcpy(snapshot.data(), src + rowSize * firstRow, rowSize * rows);
+	memcpy(snapshot.data() + rowSize * rows, view.tileFlags + firstTile, tiles);
+
+	view.h = rows;
+	view.color = snapshot.data();
+	view.depth = snapshot.data();
+	view.tileFlags = snapshot.data() + rowSize * rows;
+	return view;
+}
+
+/*
+Queue a readback into the bound pixel pack buffer. Only the tile rows covering the region are
+copied here, the view is pointed at the copy so the conversion does not race the next frame.
+*/
+void queueReadback(Buffer& buffer, const ReadRegion& region, int format, int type) {
+	int firstRow;
+	ReadbackWorker::Job job;
+	job.snapshot = context->readback->takeSnapshot();
+	job.view = snapshotFramebuffer(region, format == GL_DEPTH_COMPONENT, job.snapshot, firstRow);
+	job.region = region;
+	job.region.y -= firstRow;
+	job.format = format;
+	job.type = type;
+	buffer.writer = context->readback;
+	buffer.lastJob = context->readback->submit(job);
+}
+#pragma endregion
+
+void glPixelStorei(int pname, int param) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	switch (pname) {
+	case GL_PACK_ROW_LENGTH:
+		if (param < 0) {
+			context->err = GL_INVALID_VALUE;
+			return;
+		}
+		context->packRowLength = param;
+		break;
+	case GL_PACK_ALIGNMENT:
+		if (param != 1 && param != 2 && param != 4 && param != 8) {
+			context->err = GL_INVALID_VALUE;
+			return;
+		}
+		context->packAlignment = param;
+		break;
+	case EXT_OLC_PACK_THREADS:
+		if (param < 1) {
+			context->err = GL_INVALID_VALUE;
+			return;
+		}
+		context->packThreads = param;
+		break;
+	default:
+		context->err = GL_INVALID_ENUM;
+	}
+}
+
+// Clip a client rectangle to the framebuffer, only the part inside of it is written
+bool clipReadRegion(int x, int y, int w, int h, unsigned char* data, size_t stride, size_t pixelSize, ReadRegion& region) {
+	int x0 = glm::max(x, 0);
+	int y0 = glm::max(y, 0);
+	int x1 = glm::min(x + w, context->w);
+	int y1 = glm::min(y + h, context->h);
+	if (x0 >= x1 || y0 >= y1) return false;
+
+	region.x = x0;
+	region.y = y0;
+	region.w = x1 - x0;
+	region.h = y1 - y0;
+	region.data = data + (y0 - y) * stride + (x0 - x) * pixelSize;
+	region.stride = stride;
+	return true;
+}
+
+/*
+Split a synchronous readback in bands of whole tile rows for the convert pool. A band writes its own
+rows of client memory only. There are about four bands per thread so uneven ones even out, and none
+under GL_BAND_MIN_PIXELS, small reads stay on the calling thread.
+*/
+#define GL_BAND_MIN_PIXELS		(4096)
+
+template<typename Fn>
+void forEachBand(const ReadRegion& region, Fn fn) {
+	int threads = context->packThreads;
+	int rows = (region.h + threads * 4 - 1) / (threads * 4);
+	rows = glm::max(rows, (GL_BAND_MIN_PIXELS + region.w - 1) / region.w);
+	rows = (rows + GL_TILE_SIZE - 1) & ~(GL_TILE_SIZE - 1);
+	int bands = (region.h + rows - 1) / rows;
+
+	if (threads <= 1 || bands <= 1) {
+		fn(region);
+		return;
+	}
+
+	context->convertPool.run(threads, glm::min(threads, bands), bands, [&](int band) {
+		ReadRegion part = region;
+		part.y = region.y + band * rows;
+		part.h = glm::min(rows, region.h - band * rows);
+		part.data = region.data + (size_t)band * rows * region.stride;
+		fn(part);
+	});
+}
+
+/*
+Synchronous cell readback. With EXT_OLC_DIRTY_TILES only dirty tiles are converted, the tiles
+entirely inside of the region are clean afterwards.
+*/
+void readCellsDirty(const ReadRegion& region, const OlcCellLayoutEXT& layout, bool dither) {
+	FramebufferView view = makeFramebufferView();
+	view.dirtyOnly = context->extOlcDirtyTiles;
+	forEachBand(region, [&](const ReadRegion& band) {
+		readCells(view, band, layout, dither);
+	});
+
+	if (!view.dirtyOnly) return;
+
+	int x1 = region.x + region.w;
+	int y1 = region.y + region.h;
+	for (int ty = region.y >> GL_TILE_SHIFT; ty <= ((y1 - 1) >> GL_TILE_SHIFT); ty++) {
+		for (int tx = region.x >> GL_TILE_SHIFT; tx <= ((x1 - 1) >> GL_TILE_SHIFT); tx++) {
+			bool inside = (tx << GL_TILE_SHIFT) >= region.x && (ty << GL_TILE_SHIFT) >= region.y &&
+				glm::min((tx + 1) << GL_TILE_SHIFT, context->w) <= x1 && glm::min((ty + 1) << GL_TILE_SHIFT, context->h) <= y1;
+			if (inside) context->tileFlags[ty * context->tilesX + tx] &= ~GL_TILE_DIRTY;
+		}
+	}
+}
+
+void glReadPixels(int x, int y, int w, int h, int format, int type, void* data) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if ((format != EXT_OLC_PIXEL_FORMAT && format != GL_RGBA && format != GL_RGB && format != GL_DEPTH_COMPONENT)) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	bool isExtOlcType = type == EXT_OLC_PIXEL || type == EXT_OLC_PIXEL_DITHERED;
+
+	if ((type != GL_BYTE && type != GL_FLOAT && !isExtOlcType)) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	if ((isExtOlcType && format != EXT_OLC_PIXEL_FORMAT) || (!isExtOlcType && format == EXT_OLC_PIXEL_FORMAT)) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	if (w <= 0 || h <= 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	size_t pixelSize = readPixelSize(format, type);
+	size_t rowSize = (context->packRowLength > 0 ? context->packRowLength : w) * pixelSize;
+	size_t stride = (rowSize + context->packAlignment - 1) / context->packAlignment * context->packAlignment;
+
+	// With a pixel pack buffer bound data is an offset into it and the conversion is queued
+	if (context->curPackBuffer != nullptr) {
+		Buffer* buffer = context->curPackBuffer;
+		size_t end = (size_t)data + (h - 1) * stride + w * pixelSize;
+		if (buffer->mapped || end > buffer->size) {
+			context->err = GL_INVALID_OPERATION;
+			return;
+		}
+
+		ReadRegion region;
+		if (clipReadRegion(x, y, w, h, buffer->data + (size_t)data, stride, pixelSize, region)) {
+			queueReadback(*buffer, region, format, type);
+		}
+		return;
+	}
+
+	ReadRegion region;
+	if (!clipReadRegion(x, y, w, h, (unsigned char*)data, stride, pixelSize, region)) return;
+
+	if (format == EXT_OLC_PIXEL_FORMAT) {
+		readCellsDirty(region, olcPixelLayout, type == EXT_OLC_PIXEL_DITHERED);
+	}
+	else {
+		FramebufferView view = makeFramebufferView();
+		forEachBand(region, [&](const ReadRegion& band) {
+			readPixels(view, band, format, type);
+		});
+	}
+}
+
+void glReadCellsEXT(int x, int y, int w, int h, const OlcCellLayoutEXT* layout) {
+	finishCommands();
+	flushDraws();
+	GL_BEGIN_CHECK;
+
+	if (layout == nullptr || layout->base == nullptr || w <= 0 || h <= 0 || layout->cellSize <= 0 ||
+		(layout->glyphOffset >= 0 && layout->glyphSize != 2 && layout->glyphSize != 4) ||
+		(layout->attrOffset >= 0 && layout->attrSize != 1 && layout->attrSize != 2)) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	ReadRegion region;
+	if (clipReadRegion(x, y, w, h, (unsigned char*)layout->base, layout->stride, layout->cellSize, region)) {
+		readCellsDirty(region, *layout, false);
+	}
+}
+
+// Runs of dirty tiles per tile row, merged with the run right above when they line up
+void collectDirtyRects(const FramebufferView& view, std::vector<int>& found) {
+	found.clear();
+
+	int tilesY = (view.h + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT;
+	for (int ty = 0; ty < tilesY; ty++) {
+		const unsigned char* flags = view.tileFlags + ty * view.tilesX;
+
+		for (int tx = 0; tx < view.tilesX;) {
+			if (!(flags[tx] & GL_TILE_DIRTY)) {
+				tx++;
+				continue;
+			}
+
+			int first = tx;
+			while (tx < view.tilesX && (flags[tx] & GL_TILE_DIRTY)) tx++;
+
+			int x = first << GL_TILE_SHIFT;
+			int y = ty << GL_TILE_SHIFT;
+			int w = glm::min(tx << GL_TILE_SHIFT, view.w) - x;
+			int h = glm::min((ty + 1) << GL_TILE_SHIFT, view.h) - y;
+
+			bool merged = false;
+			for (size_t i = 0; i < found.size(); i += 4) {
+				if (found[i] == x && found[i + 2] == w && found[i + 1] + found[i + 3] == y) {
+					found[i + 3] += h;
+					merged = true;
+					break;
+				}
 			}
 
-			context->bufColor[o] = fragColor;
+			if (!merged) {
+				found.push_back(x);
+				found.push_back(y);
+				found.push_back(w);
+				found.push_back(h);
+			}
 		}
 	}
 }
 
-void drawQuad(Vertex p1, Vertex p2, Vertex p3, Vertex p4) {
-	if (context->cullingEnabled) {
-		if (!p1.cull) return;
-		p3.cull = true; // Or drawTriangle will think the second triangle making the quad is culled
+int glGetDirtyRectsEXT(int maxRects, int* rects) {
+	finishCommands();
+	flushDraws();
+	if (context->beginMode != -1 || maxRects < 0) {
+		context->err = context->beginMode != -1 ? GL_INVALID_OPERATION : GL_INVALID_VALUE;
+		return 0;
 	}
 
-	drawTriangle(p1, p2, p3);
-	drawTriangle(p3, p4, p1);
+	std::vector<int>& found = context->dirtyRects;
+	collectDirtyRects(makeFramebufferView(), found);
+
+	int count = (int)(found.size() / 4);
+	if (rects != nullptr) {
+		memcpy(rects, found.data(), glm::min(count, maxRects) * 4 * sizeof(int));
+	}
+	return count;
 }
 
-void glEnd() {
-	if (context->beginMode == -1) {
+#pragma region Buffers
+void glGenBuffers(int count, int* buf) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	if (count < 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	for (int i = 0; i < count; ++i) {
+		int id = group.buffers.create();
+		if (id == 0) {
+			context->err = GL_OUT_OF_MEMORY;
+			return;
+		}
+		*group.buffers.get(id) = new Buffer();
+		buf[i] = id;
+	}
+}
+
+void glDeleteBuffers(int count, const int* buf) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	if (count < 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	for (int i = 0; i < count; ++i) {
+		Buffer** buffer = group.buffers.get(buf[i]);
+		if (buffer == nullptr) continue;
+
+		if (context->curPackBuffer == *buffer) {
+			unrefBuffer(context->curPackBuffer);
+			context->curPackBuffer = nullptr;
+		}
+		unrefBuffer(*buffer);
+		group.buffers.destroy(buf[i]);
+	}
+}
+
+void glBindBuffer(int target, int id) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	if (target != GL_PIXEL_PACK_BUFFER) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
+
+	ShareGroup& group = *context->group;
+	std::lock_guard<std::mutex> lock(group.mutex);
+
+	Buffer* buffer = nullptr;
+	if (id != 0) {
+		Buffer** object = group.buffers.get(id);
+		if (object == nullptr) {
+			context->err = GL_INVALID_OPERATION;
+			return;
+		}
+		buffer = *object;
+		buffer->refs++;
+	}
+
+	unrefBuffer(context->curPackBuffer);
+	context->curPackBuffer = buffer;
+}
+
+Buffer* boundBuffer(int target) {
+	if (target != GL_PIXEL_PACK_BUFFER) {
+		context->err = GL_INVALID_ENUM;
+		return nullptr;
+	}
+
+	if (context->curPackBuffer == nullptr) {
 		context->err = GL_INVALID_OPERATION;
+	}
+	return context->curPackBuffer;
+}
+
+void glBufferData(int target, int size, const void* data, int usage) {
+	finishCommands();
+	GL_BEGIN_CHECK;
+
+	if (usage != GL_STREAM_READ && usage != GL_STATIC_READ && usage != GL_DYNAMIC_READ) {
+		context->err = GL_INVALID_ENUM;
 		return;
 	}
 
-	// Transform vertives and map them to window coordinates
-	for (size_t i = 0; i < context->beginVertices.size(); i++) {
-		Vertex& vertex = context->beginVertices[i];
-		
-		glm::vec4 vec(vertex.coord.x, vertex.coord.y, vertex.coord.z, 1.0f);
-		vec = context->matModelView * vec;
+	if (size < 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
 
-		// Perform back culling - if enabled
-		if (context->cullingEnabled && ((context->beginMode == GL_QUADS && i % 4 == 0) || (context->beginMode == GL_TRIANGLES && i % 3 == 0))) {
-			glm::vec3 side1 = context->beginVertices[i].coord - context->beginVertices[i + 1].coord;
-			glm::vec3 side2 = context->beginVertices[i].coord - context->beginVertices[i + 2].coord;
-			glm::vec3 normal = glm::cross(side1, side2);
-			float dot = glm::dot(normal, context->beginVertices[i].coord);
-			vertex.cull = dot <= 0;
+	Buffer* buffer = boundBuffer(target);
+	if (buffer == nullptr) return;
+
+	if (buffer->mapped) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
+
+	waitReadback(*buffer);
+
+	if ((size_t)size != buffer->size) {
+		alignedFree(buffer->data);
+		buffer->data = size > 0 ? (unsigned char*)alignedAlloc(size) : nullptr;
+		buffer->size = buffer->data != nullptr ? size : 0;
+
+		if (size > 0 && buffer->data == nullptr) {
+			context->err = GL_OUT_OF_MEMORY;
+			return;
 		}
+	}
 
-		// Transform vertex into clip space
-		vec = context->matProj * vec;
+	if (data != nullptr) {
+		memcpy(buffer->data, data, size);
+	}
+}
 
-		// Calculate normalized device coordinates
-		glm::vec3 norm(vec.x / vec.w, vec.y / vec.w, vec.z / vec.w);
+void* glMapBuffer(int target, int access) {
+	finishCommands();
+	if (context->beginMode != -1) {
+		context->err = GL_INVALID_OPERATION;
+		return nullptr;
+	}
 
-		vertex.coord.x = (norm.x + 1) / 2 * context->w;
-		vertex.coord.y = (1 - norm.y) / 2 * context->h;
-		vertex.coord.z = norm.z;
+	if (access != GL_READ_ONLY) {
+		context->err = GL_INVALID_ENUM;
+		return nullptr;
 	}
 
-	// Assemble primities
-	switch (context->beginMode) {
-	case GL_POINTS:
-		for (size_t i = 0; i < context->beginVertices.size(); i++) {
-			drawPoint(context->beginVertices[i]);
+	Buffer* buffer = boundBuffer(target);
+	if (buffer == nullptr) return nullptr;
+
+	if (buffer->mapped) {
+		context->err = GL_INVALID_OPERATION;
+		return nullptr;
+	}
+
+	// Only blocks if the last readback into the buffer is still being converted
+	waitReadback(*buffer);
+	buffer->mapped = true;
+	return buffer->data;
+}
+
+bool glUnmapBuffer(int target) {
+	finishCommands();
+	if (context->beginMode != -1) {
+		context->err = GL_INVALID_OPERATION;
+		return false;
+	}
+
+	Buffer* buffer = boundBuffer(target);
+	if (buffer == nullptr) return false;
+
+	if (!buffer->mapped) {
+		context->err = GL_INVALID_OPERATION;
+		return false;
+	}
+
+	buffer->mapped = false;
+	return true;
+}
+#pragma endregion
+
+#pragma region Frame Sinks
+void FrameSink::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		wake.wait(lock, [&] { return quit || !jobs.empty(); });
+		if (jobs.empty()) break;
+
+		Job& job = jobs.front();
+		lock.unlock();
+		bool resize = job.scaleW > 0 && (job.scaleW != job.view.w || job.scaleH != job.view.h);
+		encode(resize ? scale(job) : job.view);
+
+		// The dirty tiles of the next frame do not apply to a scaled one
+		if (resize) frameW = 0;
+		lock.lock();
+
+		spareSnapshots.push_back(std::vector<unsigned char>());
+		spareSnapshots.back().swap(job.snapshot);
+		jobs.pop_front();
+		done.notify_all();
+
+		if (jobs.empty() && !out.empty()) {
+			lock.unlock();
+			flush();
+			lock.lock();
 		}
-		break;
-	case GL_LINES:
-		for (size_t i = 0; i < context->beginVertices.size(); i += 2) {
-			drawLine(context->beginVertices[i], context->beginVertices[i + 1]);
+	}
+
+	lock.unlock();
+	flush();
+}
+
+/*
+Resample the frame as RGBA8 to the scale size, the returned view reads the result and converts it
+like a framebuffer would. GL_LINEAR weights the 4 nearest source pixels in 8 bit fixed point.
+*/
+FramebufferView FrameSink::scale(const Job& job) {
+	FramebufferView source = job.view;
+	source.dirtyOnly = false;
+	int sw = source.w;
+	int sh = source.h;
+	int dw = job.scaleW;
+	int dh = job.scaleH;
+
+	scaleSource.resize((size_t)sw * sh * 4);
+	ReadRegion region = { 0, 0, sw, sh, scaleSource.data(), (size_t)sw * 4 };
+	readPixels(source, region, GL_RGBA, GL_BYTE);
+
+	scaled.resize((size_t)dw * dh * 4);
+	const unsigned char* src = scaleSource.data();
+	unsigned char* dst = scaled.data();
+
+	if (job.scaleFilter == GL_NEAREST) {
+		for (int y = 0; y < dh; y++) {
+			const unsigned int* row = (const unsigned int*)src + (size_t)(y * sh / dh) * sw;
+			unsigned int* out = (unsigned int*)dst + (size_t)y * dw;
+			for (int x = 0; x < dw; x++) {
+				out[x] = row[x * sw / dw];
+			}
 		}
-		break;
-	case GL_TRIANGLES:
-		for (size_t i = 0; i < context->beginVertices.size(); i += 3) {
-			drawTriangle(context->beginVertices[i], context->beginVertices[i + 1], context->beginVertices[i + 2]);
+	}
+	else {
+		// Pixel centers of the destination mapped to the source, in 24.8 fixed point
+		for (int y = 0; y < dh; y++) {
+			int fy = glm::max((y * 2 + 1) * sh * 128 / dh - 128, 0);
+			int y0 = glm::min(fy >> 8, sh - 1);
+			int y1 = glm::min(y0 + 1, sh - 1);
+			int wy = fy & 0xFF;
+			const unsigned char* row0 = src + (size_t)y0 * sw * 4;
+			const unsigned char* row1 = src + (size_t)y1 * sw * 4;
+			unsigned char* out = dst + (size_t)y * dw * 4;
+
+			for (int x = 0; x < dw; x++) {
+				int fx = glm::max((x * 2 + 1) * sw * 128 / dw - 128, 0);
+				int x0 = glm::min(fx >> 8, sw - 1);
+				int x1 = glm::min(x0 + 1, sw - 1);
+				int wx = fx & 0xFF;
+
+				for (int c = 0; c < 4; c++) {
+					int top = row0[x0 * 4 + c] * (256 - wx) + row0[x1 * 4 + c] * wx;
+					int bottom = row1[x0 * 4 + c] * (256 - wx) + row1[x1 * 4 + c] * wx;
+					out[x * 4 + c] = (unsigned char)((top * (256 - wy) + bottom * wy + (1 << 15)) >> 16);
+				}
+			}
 		}
-		break;
-	case GL_QUADS:
-		for (size_t i = 0; i < context->beginVertices.size(); i += 4) {
-			drawQuad(context->beginVertices[i], context->beginVertices[i + 1], context->beginVertices[i + 2], context->beginVertices[i + 3]);
+	}
+
+	FramebufferView view = source;
+	view.w = dw;
+	view.h = dh;
+	view.colorFormat = GL_RGBA8;
+	view.color = scaled.data();
+	view.depth = nullptr;
+	view.tilesX = (dw + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT;
+	scaledTiles.assign((size_t)view.tilesX * ((dh + GL_TILE_SIZE - 1) >> GL_TILE_SHIFT), 0);
+	view.tileFlags = scaledTiles.data();
+	view.dirtyOnly = false;
+	return view;
+}
+
+void FrameSink::flush() {
+	if (!failed && !file.write(out.data(), out.size())) failed = true;
+	out.clear();
+}
+
+void FrameSink::encode(const FramebufferView& view) {
+	ReadRegion region = { 0, 0, w, h, nullptr, 0 };
+
+	// Whatever size the framebuffer had when the frame was written, pixels still holds the previous
+	// frame so with dirty tiles only the ones drawn since are converted
+	if (type == EXT_FRAME_SINK_CALLBACK) {
+		FramebufferView frame = view;
+		if (frame.w != frameW || frame.h != frameH) frame.dirtyOnly = false;
+		frameW = frame.w;
+		frameH = frame.h;
+
+		size_t pixelSize = readPixelSize(format, readType);
+		pixels.resize((size_t)frame.w * frame.h * pixelSize);
+		region.w = frame.w;
+		region.h = frame.h;
+		region.data = pixels.data();
+		region.stride = frame.w * pixelSize;
+		readPixels(frame, region, format, readType);
+
+		if (frame.dirtyOnly) {
+			collectDirtyRects(frame, rects);
 		}
-		break;
+		else {
+			int whole[] = { 0, 0, frame.w, frame.h };
+			rects.assign(whole, whole + 4);
+		}
+
+		callback(user, pixels.data(), frame.w, frame.h, rects.data(), (int)(rects.size() / 4));
+		frames++;
+		return;
 	}
 
-	context->beginMode = -1;
-	context->beginVertices.clear();
+	if (type == EXT_FRAME_SINK_ASCIICAST) {
+		cells.resize((size_t)w * h);
+		region.data = (unsigned char*)cells.data();
+		region.stride = w * sizeof(OlcPixel);
+		readPixels(view, region, EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL);
+		encodeAsciicast();
+	}
+	else {
+		pixels.resize((size_t)w * h * 4);
+		region.data = pixels.data();
+		region.stride = w * 4;
+		readPixels(view, region, GL_RGBA, GL_BYTE);
+
+		switch (type) {
+		case EXT_FRAME_SINK_RGBA:
+			out.append((const char*)pixels.data(), pixels.size());
+			break;
+		case EXT_FRAME_SINK_PPM: {
+			char name[1024];
+			char header[64];
+			snprintf(name, sizeof(name), path.c_str(), (int)frames);
+			int headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", w, h);
+
+			out.assign(header, headerSize);
+			for (size_t i = 0; i < (size_t)w * h; i++) {
+				out.append((const char*)&pixels[i * 4], 3);
+			}
+
+			SinkFile frame;
+			if (!frame.open(name) || !frame.write(out.data(), out.size()) || !frame.close()) failed = true;
+			out.clear();
+			break;
+		}
+		case EXT_FRAME_SINK_Y4M:
+			encodeY4M();
+			break;
+		}
+	}
+
+	if (out.size() >= GL_SINK_FLUSH_SIZE) flush();
+	frames++;
 }
 
-void glColor4f(float r, float g, float b, float a) {
-	context->beginColor = Pixel(r, g, b, a);
+// Full range BT.601 in 8.8 fixed point, chroma from the average of each 2x2 block
+void FrameSink::encodeY4M() {
+	int cw = (w + 1) / 2;
+	int ch = (h + 1) / 2;
+	size_t start = out.size();
+	out.append("FRAME\n");
+	out.resize(start + 6 + (size_t)w * h + (size_t)cw * ch * 2);
+
+	unsigned char* y = (unsigned char*)&out[start + 6];
+	unsigned char* u = y + (size_t)w * h;
+	unsigned char* v = u + (size_t)cw * ch;
+
+	for (size_t i = 0; i < (size_t)w * h; i++) {
+		const unsigned char* p = &pixels[i * 4];
+		y[i] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+	}
+
+	for (int cy = 0; cy < ch; cy++) {
+		int y0 = cy * 2;
+		int y1 = glm::min(y0 + 1, h - 1);
+		for (int cx = 0; cx < cw; cx++) {
+			int x0 = cx * 2;
+			int x1 = glm::min(x0 + 1, w - 1);
+			const unsigned char* p[4] = {
+				&pixels[((size_t)y0 * w + x0) * 4], &pixels[((size_t)y0 * w + x1) * 4],
+				&pixels[((size_t)y1 * w + x0) * 4], &pixels[((size_t)y1 * w + x1) * 4]
+			};
+			int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+			int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+			int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+
+			// Biased by 128 << 8 so the shifts never see a negative value
+			u[cy * cw + cx] = (unsigned char)glm::min((-43 * r - 85 * g + 128 * b + 32896) >> 8, 255);
+			v[cy * cw + cx] = (unsigned char)glm::min((128 * r - 107 * g - 21 * b + 32896) >> 8, 255);
+		}
+	}
 }
 
-void glColor3f(float r, float g, float b) {
-	context->beginColor = Pixel(r, g, b, 1.0f);
+// Console attribute (blue, green, red, intensity bits) to SGR colors
+void appendSgr(std::string& out, int attr) {
+	static const int ansi[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+	int fg = attr & 0x0F;
+	int bg = (attr >> 4) & 0x0F;
+
+	char sgr[32];
+	snprintf(sgr, sizeof(sgr), "\\u001b[%d;%dm", ((fg & 8) ? 90 : 30) + ansi[fg & 7], ((bg & 8) ? 100 : 40) + ansi[bg & 7]);
+	out.append(sgr);
 }
 
-void glTexCoord2f(float u, float v) {
-	context->beginTexCoord.x = u;
-	context->beginTexCoord.y = v;
+// A glyph as UTF-8, escaped for a JSON string
+void appendJsonGlyph(std::string& out, unsigned int c) {
+	if (c == '"' || c == '\\') {
+		out.push_back('\\');
+		out.push_back((char)c);
+	}
+	else if (c < 0x20) {
+		char escape[8];
+		snprintf(escape, sizeof(escape), "\\u%04x", c);
+		out.append(escape);
+	}
+	else if (c < 0x80) {
+		out.push_back((char)c);
+	}
+	else if (c < 0x800) {
+		out.push_back((char)(0xC0 | (c >> 6)));
+		out.push_back((char)(0x80 | (c & 0x3F)));
+	}
+	else {
+		out.push_back((char)(0xE0 | (c >> 12)));
+		out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+		out.push_back((char)(0x80 | (c & 0x3F)));
+	}
 }
 
-void glVertex3f(float x, float y, float z) {
-	if (context->beginMode == -1) {
-		context->err = GL_INVALID_OPERATION;
+/*
+One output event per frame that changed anything, every changed row is redrawn from its first column.
+The pen carries over between events like it does in the terminal playing them back.
+*/
+void FrameSink::encodeAsciicast() {
+	size_t start = out.size();
+	char text[64];
+	snprintf(text, sizeof(text), "[%.6f, \"o\", \"", (double)frames / fps);
+	out.append(text);
+	size_t empty = out.size();
+
+	if (frames == 0) {
+		out.append("\\u001b[?25l\\u001b[2J");
+		prevCells.assign(cells.size(), OlcPixel());
+	}
+
+	for (int y = 0; y < h; y++) {
+		const OlcPixel* row = &cells[(size_t)y * w];
+		OlcPixel* prevRow = &prevCells[(size_t)y * w];
+
+		bool changed = frames == 0;
+		for (int x = 0; x < w && !changed; x++) {
+			changed = row[x].c != prevRow[x].c || row[x].col != prevRow[x].col;
+		}
+		if (!changed) continue;
+
+		snprintf(text, sizeof(text), "\\u001b[%d;1H", y + 1);
+		out.append(text);
+		for (int x = 0; x < w; x++) {
+			if (row[x].col != pen) {
+				pen = row[x].col;
+				appendSgr(out, pen);
+			}
+			appendJsonGlyph(out, (unsigned int)row[x].c);
+		}
+		memcpy(prevRow, row, w * sizeof(OlcPixel));
+	}
+
+	if (out.size() == empty) {
+		out.resize(start);
 		return;
 	}
+	out.append("\"]\n");
+}
 
-	context->beginVertices.push_back(Vertex(glm::vec3(x, y, z), context->beginTexCoord, context->beginColor));
+// A single %d, optionally zero padded to a width, everything else is literal (%% included)
+bool isFramePattern(const char* path) {
+	int conversions = 0;
+	for (const char* p = path; *p != '\0'; p++) {
+		if (*p != '%') continue;
+		if (*++p == '%') continue;
+
+		if (*p == '0') p++;
+		while (*p >= '0' && *p <= '9') p++;
+		if (*p != 'd') return false;
+		conversions++;
+	}
+	return conversions == 1;
 }
 
-void glVertex2f(float x, float y) {
-	if (context->beginMode == -1) {
+int glCreateFrameSinkEXT(int type, const char* path, int fps) {
+	finishCommands();
+	if (context->beginMode != -1) {
 		context->err = GL_INVALID_OPERATION;
-		return;
+		return 0;
 	}
 
-	context->beginVertices.push_back(Vertex(glm::vec3(x, y, 1.0), context->beginTexCoord, context->beginColor));
+	if (type != EXT_FRAME_SINK_RGBA && type != EXT_FRAME_SINK_PPM && type != EXT_FRAME_SINK_ASCIICAST && type != EXT_FRAME_SINK_Y4M) {
+		context->err = GL_INVALID_ENUM;
+		return 0;
+	}
+
+	if (path == nullptr || fps <= 0 || (type == EXT_FRAME_SINK_PPM && !isFramePattern(path))) {
+		context->err = GL_INVALID_VALUE;
+		return 0;
+	}
+
+	FrameSink* sink = new FrameSink(type, context->w, context->h, fps);
+	sink->path = path;
+
+	if (type != EXT_FRAME_SINK_PPM) {
+		if (!sink->file.open(path)) {
+			delete sink;
+			context->err = GL_INVALID_OPERATION;
+			return 0;
+		}
+
+		char header[256];
+		if (type == EXT_FRAME_SINK_Y4M) {
+			snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", sink->w, sink->h, fps);
+			sink->out = header;
+		}
+		else if (type == EXT_FRAME_SINK_ASCIICAST) {
+			snprintf(header, sizeof(header), "{\"version\": 2, \"width\": %d, \"height\": %d, \"env\": {\"TERM\": \"xterm-256color\"}}\n", sink->w, sink->h);
+			sink->out = header;
+		}
+	}
+
+	int handle = context->frameSinks.create();
+	if (handle == 0) {
+		delete sink;
+		context->err = GL_OUT_OF_MEMORY;
+		return 0;
+	}
+
+	*context->frameSinks.get(handle) = sink;
+	return handle;
 }
 
-void glMatrixMode(int mode) {
-	GL_BEGIN_CHECK;
+int glCreateFrameCallbackEXT(int format, int type, int depth, OlcFrameCallbackEXT callback, void* user) {
+	finishCommands();
+	if (context->beginMode != -1) {
+		context->err = GL_INVALID_OPERATION;
+		return 0;
+	}
 
-	switch (mode) {
-	case GL_MODELVIEW:
-		context->curMatrix = &context->matModelView;
-		break;
-	case GL_PROJECTION:
-		context->curMatrix = &context->matProj;
-		break;
-	default:
+	bool isExtOlcType = type == EXT_OLC_PIXEL || type == EXT_OLC_PIXEL_DITHERED;
+	if ((format != GL_RGBA && format != EXT_OLC_PIXEL_FORMAT) || (type != GL_BYTE && type != GL_FLOAT && !isExtOlcType)) {
 		context->err = GL_INVALID_ENUM;
-		return;
+		return 0;
 	}
-}
 
-void glLoadIdentity() {
-	GL_BEGIN_CHECK;
+	if (isExtOlcType != (format == EXT_OLC_PIXEL_FORMAT)) {
+		context->err = GL_INVALID_OPERATION;
+		return 0;
+	}
+
+	if (depth <= 0 || callback == nullptr) {
+		context->err = GL_INVALID_VALUE;
+		return 0;
+	}
+
+	FrameSink* sink = new FrameSink(EXT_FRAME_SINK_CALLBACK, context->w, context->h, 1);
+	sink->maxFrames = depth;
+	sink->format = format;
+	sink->readType = type;
+	sink->callback = callback;
+	sink->user = user;
+
+	int handle = context->frameSinks.create();
+	if (handle == 0) {
+		delete sink;
+		context->err = GL_OUT_OF_MEMORY;
+		return 0;
+	}
 
-	*context->curMatrix = glm::mat4(1.0f);
+	*context->frameSinks.get(handle) = sink;
+	return handle;
 }
 
-void glTranslatef(float x, float y, float z) {
+void glFrameSinkScaleEXT(int sink, int w, int h, int filter) {
+	finishCommands();
 	GL_BEGIN_CHECK;
-	
-	*context->curMatrix = glm::translate(*context->curMatrix, glm::vec3(x, y, z));
-}
 
-void glScalef(float x, float y, float z) {
-	GL_BEGIN_CHECK;
+	FrameSink** object = context->frameSinks.get(sink);
+	if (object == nullptr || w < 0 || h < 0 || (w == 0) != (h == 0)) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
 
-	*context->curMatrix = glm::scale(*context->curMatrix, glm::vec3(x, y, z));
-}
+	if (filter != GL_NEAREST && filter != GL_LINEAR) {
+		context->err = GL_INVALID_ENUM;
+		return;
+	}
 
-void glRotatef(float angle, float x, float y, float z) {
-	GL_BEGIN_CHECK;
+	FrameSink* frameSink = *object;
+	if (frameSink->type != EXT_FRAME_SINK_CALLBACK) {
+		context->err = GL_INVALID_OPERATION;
+		return;
+	}
 
-	*context->curMatrix = glm::rotate(*context->curMatrix, angle, glm::vec3(x, y, z));
+	// The render thread is idle, it is the only one reading these
+	frameSink->scaleW = w;
+	frameSink->scaleH = h;
+	frameSink->scaleFilter = filter;
 }
 
-void glPerspective(float fovy, float aspect, float near, float far) {
-	*context->curMatrix = glm::perspective(fovy, aspect, near, far);
-}
+// Hand the tiles drawn to since the last glWriteFrameEXT to every callback sink
+void collectSinkTiles() {
+	std::vector<unsigned char>& flags = context->tileFlags;
+	for (size_t i = 0; i < context->frameSinks.slots.size(); i++) {
+		if (!context->frameSinks.slots[i].alive) continue;
 
-void glLookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ) {	
-	*context->curMatrix = glm::lookAt(glm::vec3(eyeX, eyeY, eyeZ), glm::vec3(centerX, centerY, centerZ), glm::vec3(upX, upY, upZ));
-}
+		FrameSink* sink = context->frameSinks.slots[i].object;
+		if (sink->type != EXT_FRAME_SINK_CALLBACK) continue;
 
-void glGenTextures(int count, int* buf) {
-	GL_BEGIN_CHECK;
+		// New sinks and resized framebuffers start with every tile dirty
+		if (sink->dirtyTiles.size() != flags.size()) {
+			sink->dirtyTiles.assign(flags.size(), GL_TILE_DIRTY);
+			continue;
+		}
 
-	if (count < 0) {
-		context->err = GL_INVALID_ENUM;
-		return;
+		for (size_t j = 0; j < flags.size(); j++) {
+			if (flags[j] & GL_TILE_SINK_DIRTY) sink->dirtyTiles[j] = GL_TILE_DIRTY;
+		}
 	}
 
-	for (int i = 0; i < count; ++i) {
-		int id = context->textures.size() + 1;
-		buf[i] = id;
-		context->textures.push_back(Texture());
+	for (size_t i = 0; i < flags.size(); i++) {
+		flags[i] &= ~GL_TILE_SINK_DIRTY;
 	}
 }
 
-void glBindTexture(int target, int id) {
-	GL_BEGIN_CHECK;
-
-	switch (target) {
-	case GL_TEXTURE_2D:
-		context->curTexture = id - 1;
-		break;
-	default:
-		context->err = GL_INVALID_ENUM;
+void glWriteFrameEXT(int sink) {
+	// The render thread snapshots the frame once it is drawn
+	if (recordCommand(CMD_WRITE_FRAME, sink)) {
+		context->commands->kick();
 		return;
 	}
-}
 
-void glTexImage2D(int target, int width, int height, int type, void* data) {
+	flushDraws();
 	GL_BEGIN_CHECK;
 
-	if (target != GL_TEXTURE_2D) {
-		context->err = GL_INVALID_ENUM;
+	FrameSink** object = context->frameSinks.get(sink);
+	if (object == nullptr) {
+		context->err = GL_INVALID_VALUE;
 		return;
 	}
 
-	if (type != GL_BYTE && type != GL_FLOAT) {
-		context->err = GL_INVALID_ENUM;
+	FrameSink* frameSink = *object;
+	bool resized = frameSink->type != EXT_FRAME_SINK_CALLBACK && (frameSink->w != context->w || frameSink->h != context->h);
+	if (resized || frameSink->failed) {
+		context->err = GL_INVALID_OPERATION;
 		return;
 	}
 
-	Texture& texture = context->textures[context->curTexture];
-	texture.pixels = new Pixel[width * height];
-	texture.w = width;
-	texture.h = height;
+	ReadRegion region = { 0, 0, context->w, context->h, nullptr, 0 };
+	int firstRow;
+	FrameSink::Job job;
+	job.snapshot = frameSink->takeSnapshot();
+	job.view = snapshotFramebuffer(region, false, job.snapshot, firstRow);
 
-	int size = width * height;
-	for (int i = 0; i < size; ++i) {
-		if (type == GL_BYTE) {
-			unsigned char* arr = (unsigned char*)data;
-			texture.pixels[i] = Pixel(	arr[i * 4 + 0],
-										arr[i * 4 + 1],
-										arr[i * 4 + 2],
-										arr[i * 4 + 3]);
-		}
-		else if(type == GL_FLOAT) {
-			float* arr = (float*)data;
-			texture.pixels[i] = Pixel(	arr[i * 4 + 0],
-										arr[i * 4 + 1],
-										arr[i * 4 + 2],
-										arr[i * 4 + 3]);
+	// A callback sink keeps the frame before, so the snapshot only marks the tiles drawn to since this
+	// sink was written. The dirty tiles of the context stay for readbacks and the other sinks.
+	if (frameSink->type == EXT_FRAME_SINK_CALLBACK && context->extOlcDirtyTiles) {
+		collectSinkTiles();
+
+		unsigned char* tiles = job.snapshot.data() + job.snapshot.size() - frameSink->dirtyTiles.size();
+		for (size_t i = 0; i < frameSink->dirtyTiles.size(); i++) {
+			tiles[i] = (tiles[i] & ~GL_TILE_DIRTY) | frameSink->dirtyTiles[i];
 		}
+		std::fill(frameSink->dirtyTiles.begin(), frameSink->dirtyTiles.end(), 0);
+		job.view.dirtyOnly = true;
 	}
+	frameSink->submit(job);
 }
 
-#pragma region OLC
-// this was taken from the webcam to console:
-// https://github.com/OneLoneCoder/videos/blob/master/OneLoneCoder_Webcam.cpp
+void glDeleteFrameSinkEXT(int sink) {
+	finishCommands();
+	GL_BEGIN_CHECK;
 
-enum COLOUR
-{
-	FG_BLACK = 0x0000,
-	FG_DARK_BLUE = 0x0001,
-	FG_DARK_GREEN = 0x0002,
-	FG_DARK_CYAN = 0x0003,
-	FG_DARK_RED = 0x0004,
-	FG_DARK_MAGENTA = 0x0005,
-	FG_DARK_YELLOW = 0x0006,
-	FG_GREY = 0x0007, // Thanks MS :-/
-	FG_DARK_GREY = 0x0008,
-	FG_BLUE = 0x0009,
-	FG_GREEN = 0x000A,
-	FG_CYAN = 0x000B,
-	FG_RED = 0x000C,
-	FG_MAGENTA = 0x000D,
-	FG_YELLOW = 0x000E,
-	FG_WHITE = 0x000F,
-	BG_BLACK = 0x0000,
-	BG_DARK_BLUE = 0x0010,
-	BG_DARK_GREEN = 0x0020,
-	BG_DARK_CYAN = 0x0030,
-	BG_DARK_RED = 0x0040,
-	BG_DARK_MAGENTA = 0x0050,
-	BG_DARK_YELLOW = 0x0060,
-	BG_GREY = 0x0070,
-	BG_DARK_GREY = 0x0080,
-	BG_BLUE = 0x0090,
-	BG_GREEN = 0x00A0,
-	BG_CYAN = 0x00B0,
-	BG_RED = 0x00C0,
-	BG_MAGENTA = 0x00D0,
-	BG_YELLOW = 0x00E0,
-	BG_WHITE = 0x00F0,
-};
+	FrameSink** object = context->frameSinks.get(sink);
+	if (object == nullptr) return;
 
-enum PIXEL_TYPE
-{
-	PIXEL_SOLID = 0x2588,
-	PIXEL_THREEQUARTERS = 0x2593,
-	PIXEL_HALF = 0x2592,
-	PIXEL_QUARTER = 0x2591,
-};
+	FrameSink* frameSink = *object;
+	context->frameSinks.destroy(sink);
 
-typedef struct
-{
-	float r;       // a fraction between 0 and 1
-	float g;       // a fraction between 0 and 1
-	float b;       // a fraction between 0 and 1
-} rgb;
+	frameSink->stop();
+	if (frameSink->failed) context->err = GL_INVALID_OPERATION;
+	delete frameSink;
+}
+#pragma endregion
 
-typedef struct
-{
-	float h;       // angle in degrees
-	float s;       // a fraction between 0 and 1
-	float v;       // a fraction between 0 and 1
-} hsv;
+#pragma region Render Thread
+void CommandRing::run(GLContext* ctx) {
+	context = ctx;
+	executingCommands = true;
 
-hsv rgb2hsv(rgb in)
-{
-	hsv         out;
-	float      min, max, delta;
+	unsigned long long position = tail.load(std::memory_order_relaxed);
+	int idle = 0;
 
-	min = in.r < in.g ? in.r : in.g;
-	min = min  < in.b ? min : in.b;
+	while (true) {
+		unsigned long long end = head.load(std::memory_order_acquire);
+		if (position != end) {
+			batchStart = std::chrono::steady_clock::now();
+			while (position != end) {
+				position += execute(position);
+				tail.store(position, std::memory_order_release);
+			}
+			busyTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - batchStart).count();
+			idle = 0;
+			continue;
+		}
 
-	max = in.r > in.g ? in.r : in.g;
-	max = max  > in.b ? max : in.b;
+		// Caught up, let waiters see it
+		tail.store(position, std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_seq_cst) > 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_all();
+		}
 
-	out.v = max;                                // v
-	delta = max - min;
-	if (delta < 0.00001f)
-	{
-		out.s = 0;
-		out.h = 0; // undefined, maybe nan?
-		return out;
+		if (++idle < GL_RING_SPIN) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		sleeping.store(true, std::memory_order_seq_cst);
+		wake.wait(lock, [&] { return quit || head.load(std::memory_order_seq_cst) != position; });
+		sleeping.store(false, std::memory_order_relaxed);
+		if (quit && head.load(std::memory_order_acquire) == position) return;
 	}
-	if (max > 0.0) { // NOTE: if Max is == 0, this divide would cause a crash
-		out.s = (delta / max);                  // s
+}
+
+// Execute the command at position, returns how many slots it took
+int CommandRing::execute(unsigned long long position) {
+	const Command& command = slot(position);
+	const CommandArg* a = command.args;
+
+	switch (command.op) {
+	case CMD_ENABLE: glEnable(a[0].i); break;
+	case CMD_DISABLE: glDisable(a[0].i); break;
+	case CMD_CLEAR_COLOR: glClearColor(a[0].f, a[1].f, a[2].f, a[3].f); break;
+	case CMD_CLEAR_DEPTH: glClearDepth(a[0].f); break;
+	case CMD_CLEAR: glClear(a[0].i); break;
+	case CMD_ALPHA_FUNC: glAlphaFunc(a[0].i, a[1].f); break;
+	case CMD_BLEND_FUNC: glBlendFunc(a[0].i, a[1].i); break;
+	case CMD_BEGIN: glBegin(a[0].i); break;
+	case CMD_END: glEnd(); break;
+	case CMD_COLOR: glColor4f(a[0].f, a[1].f, a[2].f, a[3].f); break;
+	case CMD_TEX_COORD: glTexCoord2f(a[0].f, a[1].f); break;
+	case CMD_VERTEX: glVertex3f(a[0].f, a[1].f, a[2].f); break;
+	case CMD_MATRIX_MODE: glMatrixMode(a[0].i); break;
+	case CMD_LOAD_IDENTITY: glLoadIdentity(); break;
+	case CMD_TRANSLATE: glTranslatef(a[0].f, a[1].f, a[2].f); break;
+	case CMD_SCALE: glScalef(a[0].f, a[1].f, a[2].f); break;
+	case CMD_ROTATE: glRotatef(a[0].f, a[1].f, a[2].f, a[3].f); break;
+	case CMD_PERSPECTIVE: glPerspective(a[0].f, a[1].f, a[2].f, a[3].f); break;
+	case CMD_LOOK_AT: {
+		const CommandArg* b = slot(position + 1).args;
+		const CommandArg* c = slot(position + 2).args;
+		glLookAt(a[0].f, a[1].f, a[2].f, a[3].f, b[0].f, b[1].f, b[2].f, b[3].f, c[0].f);
+		return 3;
 	}
-	else {
-		// if max is 0, then r = g = b = 0              
-		// s = 0, h is undefined
-		out.s = 0.0;
-		out.h = NAN;                            // its now undefined
-		return out;
+	case CMD_BIND_TEXTURE: glBindTexture(a[0].i, a[1].i); break;
+	case CMD_WRITE_FRAME: glWriteFrameEXT(a[0].i); break;
+	case CMD_QUERY_STAMP: stampQuery(a[0].i, a[1].i != 0); break;
 	}
-	if (in.r >= max)                           // > is bogus, just keeps compilor happy
-		out.h = (in.g - in.b) / delta;        // between yellow & magenta
-	else
-		if (in.g >= max)
-			out.h = 2.0 + (in.b - in.r) / delta;  // between cyan & yellow
-		else
-			out.h = 4.0 + (in.r - in.g) / delta;  // between magenta & cyan
-
-	out.h *= 60.0;                              // degrees
+	return 1;
+}
 
-	if (out.h < 0.0)
-		out.h += 360.0;
+void setAsync(bool enable) {
+	finishCommands();
+	GL_BEGIN_CHECK;
 
-	return out;
+	if (enable && context->commands == nullptr) {
+		context->commands = new CommandRing(context->commandsRetired);
+		context->commands->thread = std::thread(&CommandRing::run, context->commands, context);
+	}
+	else if (!enable && context->commands != nullptr) {
+		context->commands->stop();
+		context->commandsRetired = context->commands->issued;
+		delete context->commands;
+		context->commands = nullptr;
+	}
 }
 
-void ClassifyPixel_Grey(float r, float g, float b, wchar_t &sym, short &fg_col, short &bg_col)
-{
-	float luminance = 0.2987f * r + 0.5870f * g + 0.1140f * b;
-	int pixel_bw = (int)(luminance * 13.0f);
-	switch (pixel_bw)
-	{
-	case 0: bg_col = BG_BLACK; fg_col = FG_BLACK; sym = PIXEL_SOLID; break;
+void glFlush() {
+	if (recording()) context->commands->kick();
+}
 
-	case 1: bg_col = BG_BLACK; fg_col = FG_DARK_GREY; sym = PIXEL_QUARTER; break;
-	case 2: bg_col = BG_BLACK; fg_col = FG_DARK_GREY; sym = PIXEL_HALF; break;
-	case 3: bg_col = BG_BLACK; fg_col = FG_DARK_GREY; sym = PIXEL_THREEQUARTERS; break;
-	case 4: bg_col = BG_BLACK; fg_col = FG_DARK_GREY; sym = PIXEL_SOLID; break;
+void glFinish() {
+	finishCommands();
+	flushDraws();
+}
 
-	case 5: bg_col = BG_DARK_GREY; fg_col = FG_GREY; sym = PIXEL_QUARTER; break;
-	case 6: bg_col = BG_DARK_GREY; fg_col = FG_GREY; sym = PIXEL_HALF; break;
-	case 7: bg_col = BG_DARK_GREY; fg_col = FG_GREY; sym = PIXEL_THREEQUARTERS; break;
-	case 8: bg_col = BG_DARK_GREY; fg_col = FG_GREY; sym = PIXEL_SOLID; break;
+int glFenceSync(int condition, int flags) {
+	if (condition != GL_SYNC_GPU_COMMANDS_COMPLETE || flags != 0) {
+		finishCommands();
+		context->err = condition != GL_SYNC_GPU_COMMANDS_COMPLETE ? GL_INVALID_ENUM : GL_INVALID_VALUE;
+		return 0;
+	}
 
-	case 9:  bg_col = BG_GREY; fg_col = FG_WHITE; sym = PIXEL_QUARTER; break;
-	case 10: bg_col = BG_GREY; fg_col = FG_WHITE; sym = PIXEL_HALF; break;
-	case 11: bg_col = BG_GREY; fg_col = FG_WHITE; sym = PIXEL_THREEQUARTERS; break;
-	case 12: bg_col = BG_GREY; fg_col = FG_WHITE; sym = PIXEL_SOLID; break;
+	int sync = context->fences.create();
+	if (sync == 0) {
+		finishCommands();
+		context->err = GL_OUT_OF_MEMORY;
+		return 0;
 	}
-}
 
-void ClassifyPixel_HSL(float r, float g, float b, wchar_t &sym, short &fg_col, short &bg_col)
-{
-	hsv col = rgb2hsv({ r, g, b });
+	// Signaled once everything recorded so far executed
+	*context->fences.get(sync) = recording() ? context->commands->issued : context->commandsRetired;
+	return sync;
+}
 
-	const struct { wchar_t c; short fg; short bg; } hues[] =
-	{
-		{ PIXEL_SOLID,				FG_RED | BG_RED },
-	{ PIXEL_QUARTER,			FG_YELLOW | BG_RED },
-	{ PIXEL_HALF,				FG_YELLOW | BG_RED },
-	{ PIXEL_THREEQUARTERS,		FG_YELLOW | BG_RED },
+int glClientWaitSync(int sync, int flags, unsigned long long timeout) {
+	unsigned long long* fence = context->fences.get(sync);
+	if (fence == nullptr || (flags & ~GL_SYNC_FLUSH_COMMANDS_BIT) != 0) {
+		finishCommands();
+		context->err = GL_INVALID_VALUE;
+		return GL_WAIT_FAILED;
+	}
 
-	{ PIXEL_SOLID,				FG_GREEN | BG_YELLOW },
-	{ PIXEL_QUARTER,			FG_GREEN | BG_YELLOW },
-	{ PIXEL_HALF,				FG_GREEN | BG_YELLOW },
-	{ PIXEL_THREEQUARTERS,		FG_GREEN | BG_YELLOW },
+	if (!recording() || context->commands->tail.load(std::memory_order_acquire) >= *fence) return GL_ALREADY_SIGNALED;
+	if (timeout == 0) return GL_TIMEOUT_EXPIRED;
 
-	{ PIXEL_SOLID,				FG_CYAN | BG_GREEN },
-	{ PIXEL_QUARTER,			FG_CYAN | BG_GREEN },
-	{ PIXEL_HALF,				FG_CYAN | BG_GREEN },
-	{ PIXEL_THREEQUARTERS,		FG_CYAN | BG_GREEN },
+	// Always flushed, an unflushed fence would only ever time out
+	CommandRing& ring = *context->commands;
+	ring.kick();
+	return ring.waitFor(*fence, timeout == GL_TIMEOUT_IGNORED ? ~0ull : timeout) ? GL_CONDITION_SATISFIED : GL_TIMEOUT_EXPIRED;
+}
 
-	{ PIXEL_SOLID,				FG_BLUE | BG_CYAN },
-	{ PIXEL_QUARTER,			FG_BLUE | BG_CYAN },
-	{ PIXEL_HALF,				FG_BLUE | BG_CYAN },
-	{ PIXEL_THREEQUARTERS,		FG_BLUE | BG_CYAN },
+void glDeleteSync(int sync) {
+	context->fences.destroy(sync);
+}
 
-	{ PIXEL_SOLID,				FG_MAGENTA | BG_BLUE },
-	{ PIXEL_QUARTER,			FG_MAGENTA | BG_BLUE },
-	{ PIXEL_HALF,				FG_MAGENTA | BG_BLUE },
-	{ PIXEL_THREEQUARTERS,		FG_MAGENTA | BG_BLUE },
+// Nanoseconds for GL_TIME_ELAPSED, the render thread counts only the time it spent executing
+unsigned long long queryClock() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (executingCommands) {
+		CommandRing& ring = *context->commands;
+		return ring.busyTime + std::chrono::duration_cast<std::chrono::nanoseconds>(now - ring.batchStart).count();
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
 
-	{ PIXEL_SOLID,				FG_RED | BG_MAGENTA },
-	{ PIXEL_QUARTER,			FG_RED | BG_MAGENTA },
-	{ PIXEL_HALF,				FG_RED | BG_MAGENTA },
-	{ PIXEL_THREEQUARTERS,		FG_RED | BG_MAGENTA },
+void stampQuery(int id, bool end) {
+	TimeQuery* query = context->queries.get(id);
+	if (!end) {
+		query->start = queryClock();
+		return;
+	}
 
-	};
+	flushDraws();
+	query->result = queryClock() - query->start;
+}
 
-	int index = (int)((col.h / 360.0f) * 24.0f);
+void glGenQueries(int count, int* ids) {
+	finishCommands();
+	if (count < 0) {
+		context->err = GL_INVALID_VALUE;
+		return;
+	}
 
-	if (col.s > 0.2f)
-	{
-		sym = hues[index].c;
-		fg_col = hues[index].fg;
-		bg_col = hues[index].bg;
+	for (int i = 0; i < count; i++) {
+		int id = context->queries.create();
+		if (id == 0) {
+			context->err = GL_OUT_OF_MEMORY;
+			return;
+		}
+		ids[i] = id;
 	}
-	else
-		ClassifyPixel_Grey(r, g, b, sym, fg_col, bg_col);
 }
-#pragma endregion
 
-void glReadPixels(int x, int y, int w, int h, int format, int type, void* data) {
-	GL_BEGIN_CHECK;
+void glDeleteQueries(int count, const int* ids) {
+	finishCommands();
+	for (int i = 0; i < count; i++) {
+		if (ids[i] == context->activeQuery) context->activeQuery = 0;
+		context->queries.destroy(ids[i]);
+	}
+}
 
-	if ((format != EXT_OLC_PIXEL_FORMAT && format != GL_RGBA && format != GL_RGB && format != GL_DEPTH_COMPONENT)) {
-		context->err = GL_INVALID_ENUM;
+// Validated right away, only taking the time is recorded
+void glBeginQuery(int target, int id) {
+	TimeQuery* query = context->queries.get(id);
+	if (target != GL_TIME_ELAPSED || query == nullptr || context->activeQuery != 0) {
+		finishCommands();
+		context->err = target != GL_TIME_ELAPSED ? GL_INVALID_ENUM : GL_INVALID_OPERATION;
 		return;
 	}
 
-	bool isExtOlcType = type == EXT_OLC_PIXEL;
+	context->activeQuery = id;
+	query->ended = false;
+	if (!recordCommand(CMD_QUERY_STAMP, id, 0)) stampQuery(id, false);
+}
 
-	if ((type != GL_BYTE && type != GL_FLOAT && !isExtOlcType)) {
-		context->err = GL_INVALID_ENUM;
+void glEndQuery(int target) {
+	TimeQuery* query = context->queries.get(context->activeQuery);
+	if (target != GL_TIME_ELAPSED || query == nullptr) {
+		finishCommands();
+		context->err = target != GL_TIME_ELAPSED ? GL_INVALID_ENUM : GL_INVALID_OPERATION;
 		return;
 	}
 
-	if ((isExtOlcType && format != EXT_OLC_PIXEL_FORMAT) || (!isExtOlcType && format == EXT_OLC_PIXEL_FORMAT)) {
-		context->err = GL_INVALID_OPERATION;
-		return;
+	if (recordCommand(CMD_QUERY_STAMP, context->activeQuery, 1)) {
+		query->position = context->commands->issued;
+	}
+	else {
+		stampQuery(context->activeQuery, true);
+		query->position = context->commandsRetired;
 	}
+	query->ended = true;
+	context->activeQuery = 0;
+}
 
-	if (w <= 0 || h <= 0) {
-		context->err = GL_INVALID_VALUE;
+void glGetQueryObjectui64v(int id, int pname, unsigned long long* params) {
+	TimeQuery* query = context->queries.get(id);
+	if ((pname != GL_QUERY_RESULT && pname != GL_QUERY_RESULT_AVAILABLE) || query == nullptr || !query->ended) {
+		finishCommands();
+		context->err = pname != GL_QUERY_RESULT && pname != GL_QUERY_RESULT_AVAILABLE ? GL_INVALID_ENUM : GL_INVALID_OPERATION;
 		return;
 	}
 
-	if (format == GL_RGBA) {
-		int size = context->w * context->h;
-		for (int i = 0; i < size; i++) {
-			if (type == GL_BYTE) {
-				((unsigned char*)data)[i * 4 + 0] = context->bufColor->r * 255.0f;
-				((unsigned char*)data)[i * 4 + 1] = context->bufColor->g * 255.0f;
-				((unsigned char*)data)[i * 4 + 2] = context->bufColor->b * 255.0f;
-				((unsigned char*)data)[i * 4 + 3] = context->bufColor->a * 255.0f;
-			}
-			else if (type == GL_FLOAT) {
-				((float*)data)[i * 4 + 0] = context->bufColor->r;
-				((float*)data)[i * 4 + 1] = context->bufColor->g;
-				((float*)data)[i * 4 + 2] = context->bufColor->b;
-				((float*)data)[i * 4 + 3] = context->bufColor->a;
-			}
-		}
-	}
-	else if (format == GL_RGB) {
-		int size = context->w * context->h;
-		for (int i = 0; i < size; i++) {
-			if (type == GL_BYTE) {
-				((unsigned char*)data)[i * 3 + 0] = context->bufColor->r * 255.0f;
-				((unsigned char*)data)[i * 3 + 1] = context->bufColor->g * 255.0f;
-				((unsigned char*)data)[i * 3 + 2] = context->bufColor->b * 255.0f;
-			}
-			else if (type == GL_FLOAT) {
-				((float*)data)[i * 3 + 0] = context->bufColor->r;
-				((float*)data)[i * 3 + 1] = context->bufColor->g;
-				((float*)data)[i * 3 + 2] = context->bufColor->b;
-			}
-		}
-	}
-	else if (format == GL_DEPTH_COMPONENT) {
-		int size = context->w * context->h;
-		for (int i = 0; i < size; i++) {
-			if (type == GL_BYTE) {
-				((unsigned char*)data)[i] = (char)(context->bufDepth[i] * 255);
-			}
-			else if (type == GL_FLOAT) {
-				((float*)data)[i] = context->bufDepth[i];
-			}
+	if (recording()) {
+		CommandRing& ring = *context->commands;
+		ring.kick();
+		if (pname == GL_QUERY_RESULT_AVAILABLE) {
+			*params = ring.tail.load(std::memory_order_acquire) >= query->position;
+			return;
 		}
+		ring.waitFor(query->position, ~0ull);
 	}
-	else if (format == EXT_OLC_PIXEL_FORMAT) {
-		int size = context->w * context->h;
-		OlcPixel* pixels = (OlcPixel*)data;
-		for (int i = 0; i < size; i++) {
-			Pixel cValue = context->bufColor[i];
-			static short FG[] = { 0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009, 0x000A, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F };
-			static short BG[] = { 0x0000, 0x0010, 0x0020, 0x0030, 0x0040, 0x0050, 0x0060, 0x0070, 0x0080, 0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0 };
-			static const char* CHARS = "0123456789abcdef";
-			unsigned char r = (unsigned char)(cValue.r * 255.0f);
-			unsigned char g = (unsigned char)(cValue.g * 255.0f);
-			unsigned char b = (unsigned char)(cValue.b * 255.0f);
-
-			static Pixel cTable[] = { Pixel(0x000000FF), Pixel(0x000080FF), Pixel(0x008000FF), Pixel(0x008080FF), Pixel(0x800000FF), Pixel(0x800080FF), Pixel(0x808000FF), Pixel(0xC0C0C0FF), Pixel(0x808080FF), Pixel(0x0000FFFF), Pixel(0x00FF00FF), Pixel(0x00FFFFFF), Pixel(0xFF0000FF), Pixel(0xFF00FFFF), Pixel(0xFFFF00FF), Pixel(0xFFFFFFFF) };
-
-			//if (type == EXT_OLC_PIXEL) {
-			//	// fast way to turn color to console color, but it is not that good...
-			//	int index = (r > 128 || g > 128 || b > 128) ? 8 : 0;
-			//	index |= (r > 64) ? 4 : 0;
-			//	index |= (g > 64) ? 2 : 0;
-			//	index |= (b > 64) ? 1 : 0;
-			//	//pixels[i].c = CHARS[index];
-			//	pixels[i].c = ' ';
-			//	pixels[i].col = BG[index];
-			//}
-			wchar_t c;
-			short bg;
-			short fg;
-			ClassifyPixel_HSL(cValue.r, cValue.g, cValue.b, c, fg, bg);
-			pixels[i].c = c;
-			pixels[i].col = fg | bg;
-		}
+	else if (pname == GL_QUERY_RESULT_AVAILABLE) {
+		*params = 1;
+		return;
 	}
+
+	*params = query->result;
 }
+#pragma endregion
 
 #undef GL_BEGIN_CHECK
 #undef GL_COLOR_RGBA
@@ -12,12 +12,40 @@
 #define GL_INVALID_ENUM			(0x0500)
 #define GL_INVALID_VALUE		(0x0501)
 #define GL_INVALID_OPERATION	(0x0502)
+#define GL_OUT_OF_MEMORY		(0x0505)
 #pragma endregion
 
 #pragma region Features
 #define GL_DEPTH_TEST			(0x0B71)
 #define GL_CULL_FACE			(0x0B44)
 #define GL_TEXTURE_2D			(0x0DE1)
+#define GL_ALPHA_TEST			(0x0BC0)
+#define GL_BLEND				(0x0BE2)
+#pragma endregion
+
+#pragma region Comparison Functions
+#define GL_NEVER				(0x0200)
+#define GL_LESS					(0x0201)
+#define GL_EQUAL				(0x0202)
+#define GL_LEQUAL				(0x0203)
+#define GL_GREATER				(0x0204)
+#define GL_NOTEQUAL				(0x0205)
+#define GL_GEQUAL				(0x0206)
+#define GL_ALWAYS				(0x0207)
+#pragma endregion
+
+#pragma region Blend Factors
+#define GL_ZERO					(0x0000)
+#define GL_ONE					(0x0001)
+#define GL_SRC_COLOR			(0x0300)
+#define GL_ONE_MINUS_SRC_COLOR	(0x0301)
+#define GL_SRC_ALPHA			(0x0302)
+#define GL_ONE_MINUS_SRC_ALPHA	(0x0303)
+#define GL_DST_ALPHA			(0x0304)
+#define GL_ONE_MINUS_DST_ALPHA	(0x0305)
+#define GL_DST_COLOR			(0x0306)
+#define GL_ONE_MINUS_DST_COLOR	(0x0307)
+#define GL_SRC_ALPHA_SATURATE	(0x0308)
 #pragma endregion
 
 #pragma region Types
@@ -36,14 +64,89 @@
 #define GL_RGBA					(0x1908)
 #pragma endregion
 
+#pragma region Texture Formats
+#define GL_RGBA8							(0x8058)
+#define GL_COLOR_INDEX4_EXT					(0x80E4)
+#define GL_COLOR_INDEX8_EXT					(0x80E5)
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		(0x83F0)
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT	(0x83F1)
+#pragma endregion
+
+#pragma region Framebuffer Formats
+#define GL_RGB565				(0x8D62)
+#define GL_RGBA32F				(0x8814)
+#define GL_DEPTH_COMPONENT16	(0x81A5)
+#define GL_DEPTH_COMPONENT24	(0x81A6)
+#define GL_DEPTH_COMPONENT32F	(0x8CAC)
+#pragma endregion
+
 #pragma region OLC extensions
 // pixel format
 #define EXT_OLC_PIXEL_FORMAT			(0x2000)
+// capability, classify every pixel exactly instead of through the lookup table
+#define EXT_OLC_SLOW_COLOR				(0x2001)
+// capability, cell readbacks only convert the tiles drawn to since the previous one, see glGetDirtyRectsEXT
+#define EXT_OLC_DIRTY_TILES				(0x2002)
+// pixel store, threads converting a glReadPixels or glReadCellsEXT
+#define EXT_OLC_PACK_THREADS			(0x2003)
+// capability, calls are recorded and executed by a render thread of the context, see glFinish
+#define EXT_OLC_ASYNC					(0x2004)
+// capability, glBegin/glEnd batches are kept and drawn sorted by state at the next flush point, see glFinish
+#define EXT_OLC_DEFERRED				(0x2005)
 // type
 #define EXT_OLC_PIXEL					(0x1500)
+// type, EXT_OLC_PIXEL quantized with an ordered dither over every shade of the console palette
+#define EXT_OLC_PIXEL_DITHERED			(0x1501)
+#pragma endregion
+
+#pragma region Frame Sinks
+// raw RGBA bytes, frame after frame
+#define EXT_FRAME_SINK_RGBA				(0x2100)
+// one binary PPM per frame
+#define EXT_FRAME_SINK_PPM				(0x2101)
+// asciicast v2 of the console cells
+#define EXT_FRAME_SINK_ASCIICAST		(0x2102)
+// YUV4MPEG2 4:2:0
+#define EXT_FRAME_SINK_Y4M				(0x2103)
+// frames handed to a function, see glCreateFrameCallbackEXT
+#define EXT_FRAME_SINK_CALLBACK			(0x2104)
 #pragma endregion
 
 
+#pragma region Pixel Store
+#define GL_PACK_ROW_LENGTH		(0x0D02)
+#define GL_PACK_ALIGNMENT		(0x0D05)
+#pragma endregion
+
+#pragma region Buffer Objects
+#define GL_PIXEL_PACK_BUFFER	(0x88EB)
+#define GL_STREAM_READ			(0x88E1)
+#define GL_STATIC_READ			(0x88E5)
+#define GL_DYNAMIC_READ			(0x88E9)
+#define GL_READ_ONLY			(0x88B8)
+#pragma endregion
+
+#pragma region Queries
+#define GL_TIME_ELAPSED					(0x88BF)
+#define GL_QUERY_RESULT					(0x8866)
+#define GL_QUERY_RESULT_AVAILABLE		(0x8867)
+#pragma endregion
+
+#pragma region Filters
+#define GL_NEAREST				(0x2600)
+#define GL_LINEAR				(0x2601)
+#pragma endregion
+
+#pragma region Sync Objects
+#define GL_SYNC_GPU_COMMANDS_COMPLETE	(0x9117)
+#define GL_ALREADY_SIGNALED				(0x911A)
+#define GL_TIMEOUT_EXPIRED				(0x911B)
+#define GL_CONDITION_SATISFIED			(0x911C)
+#define GL_WAIT_FAILED					(0x911D)
+#define GL_SYNC_FLUSH_COMMANDS_BIT		(0x0001)
+#define GL_TIMEOUT_IGNORED				(0xFFFFFFFFFFFFFFFFull)
+#pragma endregion
+
 #pragma region Buffers
 #define GL_DEPTH_BUFFER_BIT		(0x0100)
 #define GL_COLOR_BUFFER_BIT		(0x0400)
@@ -56,7 +159,42 @@
 #define GL_EXTENSIONS			(0x0003)
 #pragma endregion
 
-void glInit(int w, int h);
+struct GLContext;
+
+/*
+Create a context with a w x h framebuffer (GL_RGBA32F, GL_DEPTH_COMPONENT32F) and make it current.
+The context the previous glInit on this thread created is destroyed. Returns false and changes nothing
+if w or h is not positive.
+*/
+bool glInit(int w, int h);
+/*
+Offscreen contexts, nothing about them needs a console. A context is current on one thread at a time,
+different contexts can render on different threads at the same time.
+
+glCreateContextEXT returns null if w or h is not positive, the current context is left alone. With share
+set the new context joins its share group: texture and buffer names are valid in every context of the
+group and refer to the same storage, which lives on while any context has it bound. Any number of contexts
+may draw with a shared texture, respecifying one while another context uses it is undefined.
+glDestroyContextEXT finishes its pending readbacks and frame sinks, it is no longer current on the calling thread after.
+*/
+GLContext* glCreateContextEXT(int w, int h, GLContext* share);
+void glDestroyContextEXT(GLContext* ctx);
+void glMakeCurrentEXT(GLContext* ctx);
+GLContext* glGetCurrentContextEXT();
+/*
+Select the internal formats of the framebuffer, this reallocates and clears it.
+
+colorFormat is GL_RGBA32F (the default), GL_RGBA8 or GL_RGB565 (GL_RGBA8 is shared with the texture formats).
+EXT_OLC_PIXEL_FORMAT stores the console cell of every pixel (one byte each) as the fragment is written, reading
+it back as EXT_OLC_PIXEL_FORMAT is then a lookup. Blending and RGBA readback see the color the cell shows.
+depthFormat is GL_DEPTH_COMPONENT32F (the default), GL_DEPTH_COMPONENT16 or GL_DEPTH_COMPONENT24.
+*/
+void glFramebufferFormatEXT(int colorFormat, int depthFormat);
+/*
+Resize the framebuffer to w x h, it is reallocated and cleared like by glFramebufferFormatEXT.
+Vertices map to the new size, so the same scene is drawn at a different resolution.
+*/
+void glFramebufferSizeEXT(int w, int h);
 
 const char* glGetString(int string);
 void glEnable(int capability);
@@ -65,6 +203,15 @@ int glGetError();
 void glClearColor(float r, float g, float b, float a);
 void glClearDepth(float depth);
 void glClear(int mask);
+/*
+Specify the comparison used by GL_ALPHA_TEST, fragments failing it write neither depth nor color
+*/
+void glAlphaFunc(int func, float ref);
+/*
+Specify the GL_BLEND factors, ONE/ZERO (the default) writes the fragment as is. SRC_ALPHA/ONE_MINUS_SRC_ALPHA,
+ONE/ONE and ONE/ONE_MINUS_SRC_ALPHA run dedicated kernels, every other pair takes the generic path.
+*/
+void glBlendFunc(int sfactor, int dfactor);
 void glBegin(int mode);
 void glEnd();
 
@@ -90,16 +237,202 @@ Generate texture object
 */
 void glGenTextures(int count, int* buf);
 /*
+Delete texture objects, their names may be handed out again by glGenTextures.
+Names that are stale or were never generated are silently ignored.
+*/
+void glDeleteTextures(int count, const int* buf);
+/*
 Make a texture current
 */
 void glBindTexture(int target, int id);
 /*
 Specify the pixels for a texture image
+
+type is GL_BYTE or GL_FLOAT for RGBA texels, or GL_COLOR_INDEX8_EXT / GL_COLOR_INDEX4_EXT
+for paletted texels. 4-bit indices are packed two per byte, first texel in the high
+nibble, and every row starts on a new byte.
 */
 void glTexImage2D(int target, int width, int height, int type, void* data);
+/*
+Specify a DXT1 compressed texture image, imageSize must be 8 bytes per 4x4 block
+*/
+void glCompressedTexImage2D(int target, int width, int height, int format, int imageSize, const void* data);
+/*
+Specify the RGBA palette used by the paletted formats of the current texture
+*/
+void glColorTable(int target, int width, int type, const void* data);
+/*
+Load the image of the current texture from a file, the file is memory mapped and its
+texels are copied straight into the texture storage.
+
+Binary PPM (P6, 8-bit) and uncompressed or RLE true color TGA files are loaded as RGBA8.
+Anything starting with "CGLT" is read as a ConsoleGL texture, all fields little endian:
+
+	char magic[4]			"CGLT"
+	uint32 width, height
+	uint32 format			GL_RGBA8, GL_COLOR_INDEX8_EXT, GL_COLOR_INDEX4_EXT or a DXT1 format
+	uint32 paletteSize		RGBA8 palette entries following the header, at most 256
+	uint32 dataSize			texel bytes following the palette, laid out as for glTexImage2D
+
+GL_INVALID_OPERATION is raised if the file can not be opened, GL_INVALID_VALUE if it is malformed.
+*/
+void glTexImage2DFileEXT(int target, const char* path);
+/*
+Set how glReadPixels lays out client memory. GL_PACK_ROW_LENGTH is the row length in pixels (0, the
+default, means the width being read), GL_PACK_ALIGNMENT the row alignment in bytes, 1, 2, 4 (the default) or 8.
+EXT_OLC_PACK_THREADS is how many threads split the conversion of a large read in bands of rows, 1 (the default)
+converts on the calling thread.
+*/
+void glPixelStorei(int pname, int param);
+/*
+Read a rectangle of the framebuffer. Unlike desktop GL, y counts rows from the top of the framebuffer and
+rows are written top to bottom. Pixels of the rectangle outside of the framebuffer are left untouched.
+
+While a GL_PIXEL_PACK_BUFFER is bound data is a byte offset into it. The rows are copied and the
+conversion runs on a worker thread, glMapBuffer waits for it.
+*/
 void glReadPixels(int x, int y, int w, int h, int format, int type, void* data);
 
+/*
+Buffer objects, GL_PIXEL_PACK_BUFFER is the only target
+*/
+void glGenBuffers(int count, int* buf);
+/*
+Delete buffer objects, waiting for readbacks still writing them. Stale or unknown names are ignored.
+*/
+void glDeleteBuffers(int count, const int* buf);
+void glBindBuffer(int target, int id);
+/*
+(Re)specify the storage of the bound buffer, usage is GL_STREAM_READ, GL_STATIC_READ or GL_DYNAMIC_READ.
+data may be null.
+*/
+void glBufferData(int target, int size, const void* data, int usage);
+/*
+Map the bound buffer for reading (access is GL_READ_ONLY), blocks until the readbacks into it are done.
+The buffer can not be read into or respecified until it is unmapped.
+*/
+void* glMapBuffer(int target, int access);
+bool glUnmapBuffer(int target);
+
 struct OlcPixel {
 	wchar_t c;
 	unsigned short col;
-};
\ No newline at end of file
+};
+
+/*
+Where glReadCellsEXT writes console cells. base is the cell of (x, y), rows are stride bytes apart
+and the cells of a row cellSize bytes apart. The glyph is glyphSize bytes (2 or 4) at glyphOffset
+and the attribute attrSize bytes (1 or 2) at attrOffset within a cell, a negative offset skips the field.
+
+A CHAR_INFO screen buffer is { buf, width * sizeof(CHAR_INFO), sizeof(CHAR_INFO), 0, 2, 2, 2 }.
+*/
+struct OlcCellLayoutEXT {
+	void* base;
+	int stride;
+	int cellSize;
+	int glyphOffset;
+	int glyphSize;
+	int attrOffset;
+	int attrSize;
+};
+
+/*
+Like glReadPixels with EXT_OLC_PIXEL_FORMAT, but the cells are written straight into the caller's layout
+*/
+void glReadCellsEXT(int x, int y, int w, int h, const OlcCellLayoutEXT* layout);
+
+/*
+The framebuffer is tracked in 16x16 pixel tiles. A tile is dirty once a primitive touches it or it is cleared
+to a different color. With EXT_OLC_DIRTY_TILES enabled, glReadCellsEXT and EXT_OLC_PIXEL_FORMAT glReadPixels
+(without a pixel pack buffer) skip clean tiles, so the destination must still hold the previous readback, and
+clean the tiles they read entirely.
+
+Returns the number of dirty rectangles and stores up to maxRects of them as x, y, w, h in rects (which may be null).
+*/
+int glGetDirtyRectsEXT(int maxRects, int* rects);
+
+/*
+Frame sinks write the color buffer of the current context to a file, encoding and disk I/O happen on a thread
+of the sink. The frame size is the framebuffer size at creation.
+
+	EXT_FRAME_SINK_RGBA			w * h * 4 bytes per frame, appended to path
+	EXT_FRAME_SINK_PPM			a P6 file per frame, path is a printf pattern with a single %d (e.g. "frame%04d.ppm")
+	EXT_FRAME_SINK_Y4M			full range BT.601 4:2:0 at fps frames per second, chroma is averaged over 2x2 pixels
+	EXT_FRAME_SINK_ASCIICAST	the cells EXT_OLC_PIXEL reads back, frame n at n / fps seconds, only changed rows are sent
+
+Returns the sink, or 0 with GL_INVALID_ENUM for an unknown type, GL_INVALID_VALUE for a bad pattern or fps
+and GL_INVALID_OPERATION if the file can not be created.
+*/
+int glCreateFrameSinkEXT(int type, const char* path, int fps);
+
+typedef void (*OlcFrameCallbackEXT)(void* user, const void* data, int w, int h, const int* rects, int rectCount);
+/*
+A sink that converts frames like glReadPixels (GL_RGBA with GL_BYTE or GL_FLOAT, or EXT_OLC_PIXEL_FORMAT with
+EXT_OLC_PIXEL or EXT_OLC_PIXEL_DITHERED) and calls callback with them on its thread. The w x h frame is tightly
+packed and only valid during the call, its size is the framebuffer size when it was written. glWriteFrameEXT
+waits while depth frames are queued. callback must not call GL.
+
+rects holds rectCount x, y, w, h rectangles, the parts of the frame that may differ from the previous call.
+It is the whole frame unless EXT_OLC_DIRTY_TILES is enabled, then only the tiles drawn to since the sink was
+last written are converted. Every callback sink tracks these on its own, so several of them can consume the
+same frames and glWriteFrameEXT leaves the dirty tiles of glReadCellsEXT and glGetDirtyRectsEXT as they are.
+*/
+int glCreateFrameCallbackEXT(int format, int type, int depth, OlcFrameCallbackEXT callback, void* user);
+/*
+Scale the frames of a callback sink to w x h with GL_NEAREST or GL_LINEAR before they are converted,
+the frames written so far keep the previous size. 0 x 0 (the default) hands them over at framebuffer size.
+*/
+void glFrameSinkScaleEXT(int sink, int w, int h, int filter);
+/*
+Queue the color buffer for the sink, only a copy is made. This blocks only while the sink is several frames
+behind. GL_INVALID_OPERATION if the framebuffer changed size (file sinks) or a write already failed.
+With EXT_OLC_ASYNC it is recorded and the render thread makes the copy.
+*/
+void glWriteFrameEXT(int sink);
+/*
+Write the queued frames and close the sink, GL_INVALID_OPERATION if a write failed
+*/
+void glDeleteFrameSinkEXT(int sink);
+
+/*
+With EXT_OLC_ASYNC enabled, state, matrix, glBegin/glEnd, vertex, glClear, glBindTexture and glWriteFrameEXT calls are written
+to a lock free ring and return at once, a render thread of the context executes them in order while the app
+thread goes on. Every other call (readbacks, glGetError, object creation and uploads) first waits for the
+recorded calls to finish. Errors of recorded calls show up in glGetError like before.
+
+glFlush makes sure recorded calls start executing, glEnd, glClear and glWriteFrameEXT flush on their own.
+glFinish returns once every call recorded so far executed. Without EXT_OLC_ASYNC both do nothing.
+
+With EXT_OLC_DEFERRED enabled, glEnd keeps the transformed batch with the state it was drawn with. The batches
+are drawn at the next glClear, glFinish, readback (glReadPixels, glReadCellsEXT, glGetDirtyRectsEXT,
+glWriteFrameEXT), texture upload or delete, glFramebufferFormatEXT or glDisable(EXT_OLC_DEFERRED). A glClear of
+both the color and depth buffers drops them instead. Batches that depth test without blending are grouped by
+state and drawn front to back, so which of two coplanar opaque batches wins may change, blended or
+undepth-tested batches keep their order.
+*/
+void glFlush();
+void glFinish();
+/*
+Fences, condition is GL_SYNC_GPU_COMMANDS_COMPLETE and flags 0. A fence is signaled once the calls recorded
+before it executed, right away without EXT_OLC_ASYNC.
+
+glClientWaitSync waits up to timeout nanoseconds (GL_TIMEOUT_IGNORED waits forever) and returns
+GL_ALREADY_SIGNALED, GL_CONDITION_SATISFIED, GL_TIMEOUT_EXPIRED or GL_WAIT_FAILED. flags may be
+GL_SYNC_FLUSH_COMMANDS_BIT, the calls before the fence are always flushed.
+*/
+int glFenceSync(int condition, int flags);
+int glClientWaitSync(int sync, int flags, unsigned long long timeout);
+void glDeleteSync(int sync);
+
+/*
+GL_TIME_ELAPSED queries, the nanoseconds the calls between glBeginQuery and glEndQuery took to execute. With
+EXT_OLC_ASYNC that is time the render thread spent executing them, waits for more recorded calls are left out.
+Deferred draws are drawn at glEndQuery so they are counted. A query may not span enabling or disabling EXT_OLC_ASYNC.
+
+GL_QUERY_RESULT_AVAILABLE never waits, GL_QUERY_RESULT waits for the calls before glEndQuery to execute.
+*/
+void glGenQueries(int count, int* ids);
+void glDeleteQueries(int count, const int* ids);
+void glBeginQuery(int target, int id);
+void glEndQuery(int target);
+void glGetQueryObjectui64v(int id, int pname, unsigned long long* params);
@@ -0,0 +1,739 @@
+/*
+Presents console cells on a VT/ANSI terminal (Linux terminals, ssh sessions, Windows 10 consoles).
+
+Every frame is diffed against the previous one, only the runs of changed cells are sent, the cursor
+is only moved to the start of a run and colors are only set when they change. The whole frame goes
+out with a single buffered write, so a remote session pays for what actually changed.
+
+	VTConsole vt;
+	vt.Resize(w, h);
+	vt.Begin();
+	...
+	OlcCellLayoutEXT layout = vt.Layout();
+	glReadCellsEXT(0, 0, w, h, &layout);
+	vt.Present();
+	...
+	vt.End();
+
+In the other modes every character shows several pixels, the framebuffer is PixelWidth() x PixelHeight()
+and read as RGBA:
+
+	vt.SetMode(VT_HALF_BLOCK);
+	vt.Resize(w, h);
+	glInit(vt.PixelWidth(), vt.PixelHeight());
+	...
+	glReadPixels(0, 0, vt.PixelWidth(), vt.PixelHeight(), GL_RGBA, GL_BYTE, vt.Pixels());
+	vt.Present();
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+#include "GL.h"
+
+/*
+A console cell, the glyph is a unicode code point and attr is a console attribute (FG_* | BG_*)
+*/
+struct VTCell {
+	unsigned int ch;
+	unsigned short attr;
+};
+
+struct VTFrameStats {
+	// Bytes sent for the frame
+	size_t bytes;
+	// write() (WriteFile on windows) calls it took
+	int syscalls;
+	// Cells that were sent
+	int cells;
+};
+
+enum VT_MODE {
+	// Console cells, 16 colors
+	VT_CELLS,
+	// The top pixel is the foreground of an upper half block (U+2580) and the bottom one the background, in truecolor
+	VT_HALF_BLOCK,
+	// VT_HALF_BLOCK for terminals without truecolor, the pixels are the nearest of the 240 fixed xterm colors
+	VT_HALF_BLOCK_256,
+	// 2x2 pixels per character as a quadrant block glyph in two truecolor colors
+	VT_QUADRANT,
+	// 2x4 pixels per character as a braille pattern in two truecolor colors
+	VT_BRAILLE,
+};
+
+/*
+Two vertically stacked pixels, 0xBBGGRR in VT_HALF_BLOCK or an xterm color in VT_HALF_BLOCK_256
+*/
+struct VTColorCell {
+	unsigned int top;
+	unsigned int bottom;
+};
+
+/*
+A block of pixels split in two colors, bit i of mask is set if pixel i (row major) is the foreground.
+A cell of one color has no bits set and fg equal to bg.
+*/
+struct VTGlyphCell {
+	unsigned int mask;
+	unsigned int fg;
+	unsigned int bg;
+};
+
+class VTConsole
+{
+public:
+#ifdef _WIN32
+	VTConsole() : m_hOut(GetStdHandle(STD_OUTPUT_HANDLE)) {}
+#else
+	VTConsole(int fd = STDOUT_FILENO) : m_fd(fd) {}
+#endif
+
+	~VTConsole()
+	{
+		if (m_bActive)
+			End();
+	}
+
+	void Resize(int width, int height)
+	{
+		m_nWidth = width;
+		m_nHeight = height;
+		m_cells.assign(width * height, VTCell{ ' ', 0x0007 });
+		m_prev.assign(width * height, VTCell{ ' ', 0x0007 });
+		if (m_nMode != VT_CELLS)
+			m_pixels.assign(PixelWidth() * PixelHeight(), 0);
+		if (m_nMode == VT_HALF_BLOCK || m_nMode == VT_HALF_BLOCK_256) {
+			m_colors.assign(width * height, VTColorCell{ 0, 0 });
+			m_prevColors.assign(width * height, VTColorCell{ 0, 0 });
+		}
+		if (m_nMode == VT_QUADRANT || m_nMode == VT_BRAILLE) {
+			m_glyphs.assign(width * height, VTGlyphCell{ 0, 0, 0 });
+			m_prevGlyphs.assign(width * height, VTGlyphCell{ 0, 0, 0 });
+		}
+		m_bRedraw = true;
+	}
+
+	// One of VT_MODE, resizes the buffers
+	void SetMode(int mode)
+	{
+		m_nMode = mode;
+		Resize(m_nWidth, m_nHeight);
+	}
+
+	int Mode() const { return m_nMode; }
+	int Width() const { return m_nWidth; }
+	int Height() const { return m_nHeight; }
+
+	// Size of the framebuffer that is shown
+	int PixelWidth() const
+	{
+		return m_nMode == VT_QUADRANT || m_nMode == VT_BRAILLE ? m_nWidth * 2 : m_nWidth;
+	}
+
+	int PixelHeight() const
+	{
+		switch (m_nMode) {
+		case VT_CELLS: return m_nHeight;
+		case VT_BRAILLE: return m_nHeight * 4;
+		default: return m_nHeight * 2;
+		}
+	}
+
+	VTCell* Cells() { return m_cells.data(); }
+
+	// Where glReadPixels should write the RGBA pixels in all but VT_CELLS
+	void* Pixels() { return m_pixels.data(); }
+
+	// Where glReadCellsEXT should write the cells
+	OlcCellLayoutEXT Layout()
+	{
+		return { m_cells.data(), m_nWidth * (int)sizeof(VTCell), sizeof(VTCell),
+			offsetof(VTCell, ch), sizeof(unsigned int), offsetof(VTCell, attr), sizeof(unsigned short) };
+	}
+
+	// The size of the terminal in cells, false if it is not a terminal
+	bool TerminalSize(int& width, int& height)
+	{
+#ifdef _WIN32
+		CONSOLE_SCREEN_BUFFER_INFO csbi;
+		if (!GetConsoleScreenBufferInfo(m_hOut, &csbi))
+			return false;
+		width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+		height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+#else
+		winsize ws;
+		if (ioctl(m_fd, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0)
+			return false;
+		width = ws.ws_col;
+		height = ws.ws_row;
+#endif
+		return true;
+	}
+
+	// Switch to the alternate screen and hide the cursor
+	void Begin()
+	{
+#ifdef _WIN32
+		DWORD mode = 0;
+		GetConsoleMode(m_hOut, &mode);
+		SetConsoleMode(m_hOut, mode | ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+		SetConsoleOutputCP(CP_UTF8);
+#endif
+		m_bActive = true;
+		m_bRedraw = true;
+		m_out.clear();
+		Append("\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J");
+		Flush();
+	}
+
+	// Restore the terminal
+	void End()
+	{
+		m_bActive = false;
+		m_out.clear();
+		Append("\x1b[0m\x1b[?25h\x1b[?1049l");
+		Flush();
+	}
+
+	// The title is sent with the next frame, and only if it changed
+	void SetTitle(const wchar_t* title)
+	{
+		std::vector<char> osc;
+		osc.push_back('\x1b');
+		osc.push_back(']');
+		osc.push_back('0');
+		osc.push_back(';');
+		for (; *title; title++)
+			AppendUtf8(osc, (unsigned int)*title);
+		osc.push_back('\x07');
+
+		if (osc != m_title) {
+			m_title = osc;
+			m_bTitle = true;
+		}
+	}
+
+	// Force the next frame to be sent whole, after something else wrote to the terminal
+	void Invalidate()
+	{
+		m_bRedraw = true;
+	}
+
+	// Send the cells that changed since the last frame
+	const VTFrameStats& Present()
+	{
+		m_out.clear();
+		m_stats.cells = 0;
+
+		if (m_bTitle) {
+			m_out.insert(m_out.end(), m_title.begin(), m_title.end());
+			m_bTitle = false;
+		}
+
+		if (m_bRedraw) {
+			// Nothing is known about the terminal
+			m_nCursorX = -1;
+			m_nCursorY = -1;
+			m_nPenFg = -1;
+			m_nPenBg = -1;
+		}
+
+		switch (m_nMode) {
+		case VT_CELLS:
+			Diff(m_cells.data(), m_prev.data());
+			break;
+		case VT_QUADRANT:
+			ConvertGlyphs<2>();
+			Diff(m_glyphs.data(), m_prevGlyphs.data());
+			break;
+		case VT_BRAILLE:
+			ConvertGlyphs<4>();
+			Diff(m_glyphs.data(), m_prevGlyphs.data());
+			break;
+		default:
+			ConvertPixels();
+			Diff(m_colors.data(), m_prevColors.data());
+			break;
+		}
+		m_bRedraw = false;
+
+		Flush();
+		return m_stats;
+	}
+
+	const VTFrameStats& Stats() const { return m_stats; }
+
+private:
+	// Send the runs of cells that differ from prev and update it
+	template<typename T>
+	void Diff(const T* cells, T* prevCells)
+	{
+		for (int y = 0; y < m_nHeight; y++) {
+			const T* cur = &cells[y * m_nWidth];
+			T* prev = &prevCells[y * m_nWidth];
+
+			if (!m_bRedraw && memcmp(cur, prev, m_nWidth * sizeof(T)) == 0)
+				continue;
+
+			int x = 0;
+			while (x < m_nWidth) {
+				if (!m_bRedraw && Same(cur[x], prev[x])) {
+					x++;
+					continue;
+				}
+
+				MoveTo(x, y, cur);
+
+				// The run of changed cells
+				while (x < m_nWidth && (m_bRedraw || !Same(cur[x], prev[x]))) {
+					Put(cur[x]);
+					prev[x] = cur[x];
+					x++;
+				}
+				m_nCursorX = x;
+			}
+
+			// Past the last column the cursor waits to wrap, where it is depends on the terminal
+			if (m_nCursorX >= m_nWidth)
+				m_nCursorX = -1;
+		}
+	}
+
+	// Pair up the rows of pixels
+	void ConvertPixels()
+	{
+		const unsigned char* pixels = (const unsigned char*)m_pixels.data();
+		const unsigned char* lut = m_nMode == VT_HALF_BLOCK_256 ? Xterm256().index : nullptr;
+
+		for (int y = 0; y < m_nHeight; y++) {
+			const unsigned char* top = pixels + (y * 2) * m_nWidth * 4;
+			const unsigned char* bottom = top + m_nWidth * 4;
+			VTColorCell* out = &m_colors[y * m_nWidth];
+
+			if (lut) {
+				for (int x = 0; x < m_nWidth; x++) {
+					out[x].top = lut[((top[x * 4] >> 3) << 10) | ((top[x * 4 + 1] >> 3) << 5) | (top[x * 4 + 2] >> 3)];
+					out[x].bottom = lut[((bottom[x * 4] >> 3) << 10) | ((bottom[x * 4 + 1] >> 3) << 5) | (bottom[x * 4 + 2] >> 3)];
+				}
+			}
+			else {
+				for (int x = 0; x < m_nWidth; x++) {
+					out[x].top = top[x * 4] | (top[x * 4 + 1] << 8) | (top[x * 4 + 2] << 16);
+					out[x].bottom = bottom[x * 4] | (bottom[x * 4 + 1] << 8) | (bottom[x * 4 + 2] << 16);
+				}
+			}
+		}
+	}
+
+	/*
+	Split every 2 x ROWS block of pixels in the ones brighter than the block's mean and the rest, each
+	side gets its mean color. There is no search over the glyphs, the mask picks the glyph, and the
+	loops are fixed size and branch free so they vectorize.
+	*/
+	template<int ROWS>
+	void ConvertGlyphs()
+	{
+		const int SAMPLES = ROWS * 2;
+		const unsigned char* pixels = (const unsigned char*)m_pixels.data();
+		size_t pitch = m_nWidth * 2 * 4;
+
+		for (int y = 0; y < m_nHeight; y++) {
+			VTGlyphCell* out = &m_glyphs[y * m_nWidth];
+
+			for (int x = 0; x < m_nWidth; x++) {
+				int rgb[SAMPLES][3];
+				int luma[SAMPLES];
+				int sum = 0;
+				for (int i = 0; i < SAMPLES; i++) {
+					const unsigned char* p = pixels + (y * ROWS + i / 2) * pitch + (x * 2 + i % 2) * 4;
+					rgb[i][0] = p[0];
+					rgb[i][1] = p[1];
+					rgb[i][2] = p[2];
+					luma[i] = 2 * p[0] + 5 * p[1] + p[2];
+					sum += luma[i];
+				}
+
+				unsigned int mask = 0;
+				int count = 0;
+				int fg[3] = { 0, 0, 0 };
+				int all[3] = { 0, 0, 0 };
+				for (int i = 0; i < SAMPLES; i++) {
+					int set = luma[i] * SAMPLES > sum;
+					mask |= set << i;
+					count += set;
+					for (int c = 0; c < 3; c++) {
+						fg[c] += rgb[i][c] * set;
+						all[c] += rgb[i][c];
+					}
+				}
+
+				unsigned int fgColor = 0;
+				unsigned int bgColor = 0;
+				for (int c = 0; c < 3; c++) {
+					int bgCount = SAMPLES - count;
+					bgColor |= ((all[c] - fg[c] + bgCount / 2) / bgCount) << (c * 8);
+					fgColor |= (count ? (fg[c] + count / 2) / count : 0) << (c * 8);
+				}
+
+				out[x].mask = mask;
+				out[x].fg = count ? fgColor : bgColor;
+				out[x].bg = bgColor;
+			}
+		}
+	}
+
+	// The glyph of a VTGlyphCell mask
+	unsigned int Glyph(unsigned int mask) const
+	{
+		// Top left, top right, bottom left, bottom right
+		static const unsigned short quadrants[16] = {
+			' ', 0x2598, 0x259D, 0x2580, 0x2596, 0x258C, 0x259E, 0x259B,
+			0x2597, 0x259A, 0x2590, 0x259C, 0x2584, 0x2599, 0x259F, 0x2588,
+		};
+
+		if (m_nMode == VT_QUADRANT)
+			return quadrants[mask];
+
+		// Braille numbers the dots down the left column then the right one, the bottom row comes last
+		unsigned int dots = (mask & 0x01) | ((mask & 0x04) >> 1) | ((mask & 0x10) >> 2) |
+			((mask & 0x02) << 2) | ((mask & 0x08) << 1) | (mask & 0x20) | (mask & 0xC0);
+		return 0x2800 + dots;
+	}
+
+	// Nearest xterm color of every 5 bit per channel color, the 16 system colors are left out since
+	// every terminal has its own
+	struct Xterm256Table {
+		unsigned char index[32 * 32 * 32];
+
+		Xterm256Table()
+		{
+			static const int levels[6] = { 0, 95, 135, 175, 215, 255 };
+
+			for (int i = 0; i < 32 * 32 * 32; i++) {
+				int rgb[3] = { ((i >> 10) << 3) | 4, (((i >> 5) & 31) << 3) | 4, ((i & 31) << 3) | 4 };
+
+				// The cube is separable, each channel goes to its nearest level
+				int cube[3];
+				int cubeDist = 0;
+				for (int c = 0; c < 3; c++) {
+					cube[c] = rgb[c] < 48 ? 0 : (rgb[c] < 115 ? 1 : (rgb[c] - 35) / 40);
+					cubeDist += (rgb[c] - levels[cube[c]]) * (rgb[c] - levels[cube[c]]);
+				}
+
+				int grey = ((rgb[0] + rgb[1] + rgb[2]) / 3 - 3) / 10;
+				grey = grey < 0 ? 0 : (grey > 23 ? 23 : grey);
+				int greyDist = 0;
+				for (int c = 0; c < 3; c++)
+					greyDist += (rgb[c] - (8 + grey * 10)) * (rgb[c] - (8 + grey * 10));
+
+				index[i] = (unsigned char)(greyDist < cubeDist ? 232 + grey : 16 + cube[0] * 36 + cube[1] * 6 + cube[2]);
+			}
+		}
+	};
+
+	static const Xterm256Table& Xterm256()
+	{
+		static const Xterm256Table table;
+		return table;
+	}
+
+	static bool Same(const VTCell& a, const VTCell& b)
+	{
+		return a.ch == b.ch && a.attr == b.attr;
+	}
+
+	static bool Same(const VTColorCell& a, const VTColorCell& b)
+	{
+		return a.top == b.top && a.bottom == b.bottom;
+	}
+
+	static bool Same(const VTGlyphCell& a, const VTGlyphCell& b)
+	{
+		return a.mask == b.mask && a.fg == b.fg && a.bg == b.bg;
+	}
+
+	static void AppendUtf8(std::vector<char>& out, unsigned int c)
+	{
+		if (c < 0x80) {
+			out.push_back((char)c);
+		}
+		else if (c < 0x800) {
+			out.push_back((char)(0xC0 | (c >> 6)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x10000) {
+			out.push_back((char)(0xE0 | (c >> 12)));
+			out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else {
+			out.push_back((char)(0xF0 | (c >> 18)));
+			out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+			out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		}
+	}
+
+	static int Utf8Size(unsigned int c)
+	{
+		return c < 0x80 ? 1 : (c < 0x800 ? 2 : (c < 0x10000 ? 3 : 4));
+	}
+
+	static int Digits(int n)
+	{
+		return n < 10 ? 1 : (n < 100 ? 2 : (n < 1000 ? 3 : 4));
+	}
+
+	void Append(const char* s)
+	{
+		m_out.insert(m_out.end(), s, s + strlen(s));
+	}
+
+	void AppendInt(int n)
+	{
+		char buf[12];
+		int len = 0;
+		do {
+			buf[len++] = (char)('0' + n % 10);
+			n /= 10;
+		} while (n);
+		while (len)
+			m_out.push_back(buf[--len]);
+	}
+
+	// Console colors are BGR with an intensity bit, SGR colors are RGB
+	static int SgrColor(int col)
+	{
+		return ((col & 4) >> 2) | (col & 2) | ((col & 1) << 2);
+	}
+
+	void AppendColor(bool fg, int col)
+	{
+		if (m_nMode == VT_CELLS) {
+			AppendInt((col & 8 ? (fg ? 90 : 100) : (fg ? 30 : 40)) + SgrColor(col));
+		}
+		else if (m_nMode == VT_HALF_BLOCK_256) {
+			Append(fg ? "38;5;" : "48;5;");
+			AppendInt(col);
+		}
+		else {
+			Append(fg ? "38;2;" : "48;2;");
+			AppendInt(col & 0xFF);
+			m_out.push_back(';');
+			AppendInt((col >> 8) & 0xFF);
+			m_out.push_back(';');
+			AppendInt((col >> 16) & 0xFF);
+		}
+	}
+
+	// One SGR for whatever of the two colors is not set already
+	void SetPen(int fg, int bg)
+	{
+		bool setFg = fg != m_nPenFg;
+		bool setBg = bg != m_nPenBg;
+		if (!setFg && !setBg)
+			return;
+
+		Append("\x1b[");
+		if (setFg)
+			AppendColor(true, fg);
+		if (setFg && setBg)
+			m_out.push_back(';');
+		if (setBg)
+			AppendColor(false, bg);
+		m_out.push_back('m');
+		m_nPenFg = fg;
+		m_nPenBg = bg;
+	}
+
+	void Put(const VTCell& cell)
+	{
+		SetPen(cell.attr & 0xF, (cell.attr >> 4) & 0xF);
+		AppendUtf8(m_out, cell.ch);
+		m_stats.cells++;
+	}
+
+	void Put(const VTColorCell& cell)
+	{
+		int top = (int)cell.top;
+		int bottom = (int)cell.bottom;
+
+		if (top == bottom) {
+			// A space only needs the background
+			SetPen(m_nPenFg, bottom);
+			m_out.push_back(' ');
+		}
+		else if ((bottom != m_nPenFg) + (top != m_nPenBg) < (top != m_nPenFg) + (bottom != m_nPenBg)) {
+			// The colors are the other way around, a lower half block needs fewer of them set
+			SetPen(bottom, top);
+			AppendUtf8(m_out, 0x2584);
+		}
+		else {
+			SetPen(top, bottom);
+			AppendUtf8(m_out, 0x2580);
+		}
+		m_stats.cells++;
+	}
+
+	void Put(const VTGlyphCell& cell)
+	{
+		int fg = (int)cell.fg;
+		int bg = (int)cell.bg;
+
+		if (!cell.mask) {
+			SetPen(m_nPenFg, bg);
+			m_out.push_back(' ');
+		}
+		else if (m_nMode == VT_QUADRANT && fg == m_nPenBg && bg == m_nPenFg) {
+			// The inverse quadrant with the colors swapped looks the same
+			AppendUtf8(m_out, Glyph(cell.mask ^ 0xF));
+		}
+		else {
+			SetPen(fg, bg);
+			AppendUtf8(m_out, Glyph(cell.mask));
+		}
+		m_stats.cells++;
+	}
+
+	// Bytes it takes to send the cell again without changing colors, -1 if it needs other colors
+	int ResendSize(const VTCell& cell)
+	{
+		return (cell.attr & 0xF) == m_nPenFg && ((cell.attr >> 4) & 0xF) == m_nPenBg ? Utf8Size(cell.ch) : -1;
+	}
+
+	int ResendSize(const VTColorCell& cell)
+	{
+		int top = (int)cell.top;
+		int bottom = (int)cell.bottom;
+		if (top == bottom)
+			return bottom == m_nPenBg ? 1 : -1;
+		return (top == m_nPenFg && bottom == m_nPenBg) || (top == m_nPenBg && bottom == m_nPenFg) ? 3 : -1;
+	}
+
+	int ResendSize(const VTGlyphCell& cell)
+	{
+		int fg = (int)cell.fg;
+		int bg = (int)cell.bg;
+		if (!cell.mask)
+			return bg == m_nPenBg ? 1 : -1;
+		if (m_nMode == VT_QUADRANT && fg == m_nPenBg && bg == m_nPenFg)
+			return 3;
+		return fg == m_nPenFg && bg == m_nPenBg ? 3 : -1;
+	}
+
+	// Move the cursor to (x, y) the cheapest way, row holds the cells of y
+	template<typename T>
+	void MoveTo(int x, int y, const T* row)
+	{
+		if (m_nCursorY == y && m_nCursorX == x)
+			return;
+
+		if (m_nCursorY == y && m_nCursorX >= 0 && m_nCursorX < x) {
+			int gap = x - m_nCursorX;
+			int forward = gap == 1 ? 3 : 3 + Digits(gap);
+
+			// Resending a short gap is cheaper than moving over it if the colors stay
+			int resend = 0;
+			for (int i = m_nCursorX; i < x && resend <= forward; i++) {
+				int size = ResendSize(row[i]);
+				resend = size < 0 ? forward + 1 : resend + size;
+			}
+
+			if (resend <= forward) {
+				for (int i = m_nCursorX; i < x; i++)
+					Put(row[i]);
+			}
+			else {
+				Append("\x1b[");
+				if (gap > 1)
+					AppendInt(gap);
+				m_out.push_back('C');
+			}
+		}
+		else if (x == 0 && m_nCursorY >= 0 && m_nCursorY + 1 == y && m_nCursorX >= 0) {
+			Append("\r\n");
+		}
+		else {
+			Append("\x1b[");
+			AppendInt(y + 1);
+			if (x > 0) {
+				m_out.push_back(';');
+				AppendInt(x + 1);
+			}
+			m_out.push_back('H');
+		}
+
+		m_nCursorX = x;
+		m_nCursorY = y;
+	}
+
+	// One write for the whole frame, more only if the terminal takes it partially
+	void Flush()
+	{
+		m_stats.bytes = m_out.size();
+		m_stats.syscalls = 0;
+
+		size_t off = 0;
+		while (off < m_out.size()) {
+#ifdef _WIN32
+			DWORD written = 0;
+			m_stats.syscalls++;
+			if (!WriteFile(m_hOut, m_out.data() + off, (DWORD)(m_out.size() - off), &written, NULL))
+				break;
+#else
+			m_stats.syscalls++;
+			ssize_t written = write(m_fd, m_out.data() + off, m_out.size() - off);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+#endif
+			off += written;
+		}
+
+		// What made it out is unknown, start over
+		if (off < m_out.size())
+			m_bRedraw = true;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE m_hOut;
+#else
+	int m_fd;
+#endif
+	int m_nMode = VT_CELLS;
+	int m_nWidth = 0;
+	int m_nHeight = 0;
+	std::vector<VTCell> m_cells;
+	std::vector<VTCell> m_prev;
+	std::vector<unsigned int> m_pixels;
+	std::vector<VTColorCell> m_colors;
+	std::vector<VTColorCell> m_prevColors;
+	std::vector<VTGlyphCell> m_glyphs;
+	std::vector<VTGlyphCell> m_prevGlyphs;
+	std::vector<char> m_out;
+	std::vector<char> m_title;
+	bool m_bTitle = false;
+	bool m_bRedraw = true;
+	bool m_bActive = false;
+	int m_nCursorX = -1;
+	int m_nCursorY = -1;
+	int m_nPenFg = -1;
+	int m_nPenBg = -1;
+	VTFrameStats m_stats = {};
+};
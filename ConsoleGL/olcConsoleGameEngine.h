@@ -43,6 +43,9 @@ this in this function and not your class constructor). Override the OnUserUpdate
 function with the good stuff, it gives you the elapsed time since the last call so you
 can modify your stuff dynamically. Both functions should return true, unless you need
 the application to close.
+The loop is held to 60 frames a second, SetTargetFps changes that (0 runs flat out). For a
+simulation that steps at a fixed rate call SetFixedTimestep and override OnFixedUpdate,
+GetFrameAlpha tells how far between two steps the frame being drawn is.
 int main()
 {
 // Use olcConsoleGameEngine derived app
@@ -74,10 +77,12 @@ http://www.twitch.tv/javidx9
 
 #pragma once
 
+#ifdef _WIN32
 #ifndef UNICODE
 #error Please enable UNICODE for your compiler! VS: Project Properties -> General -> \
 Character Set -> Use Unicode. Thanks! - Javidx9
 #endif
+#endif
 
 #include <iostream>
 #include <chrono>
@@ -85,17 +90,47 @@ Character Set -> Use Unicode. Thanks! - Javidx9
 #include <list>
 #include <thread>
 #include <atomic>
+#include <mutex>
 #include <condition_variable>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
 using namespace std;
 
+#ifdef _WIN32
 #include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#else
+// Anywhere else the screen is a VT terminal
+#include <csignal>
+#include <cwchar>
+#include "VTConsole.h"
+#endif
 
 #include "GL.h"
 
 class olcConsoleGameEngine
 {
 private:
-	OlcPixel* bufferPixels = nullptr;
+	// More dirty rectangles than this and the whole screen is written
+	static const int MAX_DIRTY_RECTS = 32;
+	// Fixed updates a frame may run, past that the simulation slows down instead of falling further behind
+	static const int MAX_FIXED_STEPS = 8;
+	// Longest a frame deadline is spun for, a run of badly late sleeps must not turn pacing into a busy loop
+	static const int MAX_SPIN_MICROSECONDS = 2000;
+	// Frames the render cost has to stay over the budget before the resolution drops, and under the low
+	// mark before it goes back up. Going up is slow on purpose so the resolution does not oscillate.
+	static const int DYNRES_DOWN_FRAMES = 3;
+	static const int DYNRES_UP_FRAMES = 30;
+
+	// GL_TIME_ELAPSED query of a frame and the resolution scale it was rendered at
+	struct sFrameQuery
+	{
+		int id;
+		bool pending;
+		float scale;
+	};
 
 public:
 	olcConsoleGameEngine()
@@ -103,8 +138,10 @@ public:
 		m_nScreenWidth = 80;
 		m_nScreenHeight = 30;
 
+#ifdef _WIN32
 		m_hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
 		m_hConsoleIn = GetStdHandle(STD_INPUT_HANDLE);
+#endif
 
 		memset(m_keyNewState, 0, 256 * sizeof(short));
 		memset(m_keyOldState, 0, 256 * sizeof(short));
@@ -113,21 +150,36 @@ public:
 		m_mousePosY = 0;
 
 		m_sAppName = L"Default";
+
+		m_nPipelineDepth = 1;
+		m_nFrameSink = 0;
+
+		m_fTargetFps = 60.0f;
+		m_fFixedTimestep = 0.0f;
+		m_fAccumulator = 0.0f;
+		m_fFrameAlpha = 0.0f;
+		m_dSleepMean = 0.001;
+		m_dSleepVar = 0.0;
+
+		m_fMinResolutionScale = 1.0f;
+		m_fResolutionScale = 1.0f;
+		m_fNextResolutionScale = 1.0f;
+		m_nUpscaleFilter = GL_NEAREST;
+		m_fRenderCost = 0.0f;
+		m_nOverBudget = 0;
+		m_nUnderBudget = 0;
+		m_nFrame = 0;
 	}
 
+#ifdef _WIN32
 	int ConstructConsole(int width, int height, int fontw, int fonth)
 	{
 		if (m_hConsole == INVALID_HANDLE_VALUE)
 			return Error(L"Bad Handle");
 
-		if (bufferPixels != nullptr) {
-			delete[] bufferPixels;
-		}
 		m_nScreenWidth = width;
 		m_nScreenHeight = height;
 
-		bufferPixels = new OlcPixel[m_nScreenWidth * m_nScreenHeight];
-
 		// Update 13/09/2017 - It seems that the console behaves differently on some systems
 		// and I'm unsure why this is. It could be to do with windows default settings, or
 		// screen resolutions, or system languages. Unfortunately, MSDN does not offer much
@@ -190,28 +242,77 @@ public:
 		m_bufScreen = new CHAR_INFO[m_nScreenWidth*m_nScreenHeight];
 		memset(m_bufScreen, 0, sizeof(CHAR_INFO) * m_nScreenWidth * m_nScreenHeight);
 
+		m_bConsoleReady = true;
 		return 1;
 	}
+#else
+	int ConstructConsole(int width, int height, int, int)
+	{
+		m_nScreenWidth = width;
+		m_nScreenHeight = height;
+
+		// The font is up to the terminal, the screen just has to fit in it
+		int termWidth, termHeight;
+		if (m_vt.TerminalSize(termWidth, termHeight))
+		{
+			if (m_nScreenHeight > termHeight)
+				return Error(L"Screen Height Too Big");
+			if (m_nScreenWidth > termWidth)
+				return Error(L"Screen Width Too Big");
+		}
+
+		// The terminal owns the screen buffer, it keeps the previous frame to diff against
+		m_vt.Resize(m_nScreenWidth, m_nScreenHeight);
+		m_bufScreen = m_vt.Cells();
+
+		// Ctrl+C ends the game cleanly so the terminal is restored
+		signal(SIGINT, InterruptHandler);
+
+		m_bConsoleReady = true;
+		return 1;
+	}
+
+	// One of VT_MODE, outside of VT_CELLS the framebuffer has several pixels per character and Draw is not shown
+	void SetTerminalMode(int mode)
+	{
+		m_vt.SetMode(mode);
+		m_bufScreen = m_vt.Cells();
+	}
+#endif
 
 	virtual void Draw(int x, int y, wchar_t c = 0x2588, short col = 0x000F)
 	{
+		// The present thread owns the screen buffer while the frames are pipelined
+		if (m_nPipelineDepth > 0)
+			return;
+
 		if (x >= 0 && x < m_nScreenWidth && y >= 0 && y < m_nScreenHeight)
 		{
+#ifdef _WIN32
 			m_bufScreen[y * m_nScreenWidth + x].Char.UnicodeChar = c;
 			m_bufScreen[y * m_nScreenWidth + x].Attributes = col;
+#else
+			m_bufScreen[y * m_nScreenWidth + x].ch = c;
+			m_bufScreen[y * m_nScreenWidth + x].attr = col;
+#endif
 		}
 	}
 
 	~olcConsoleGameEngine()
 	{
+#ifdef _WIN32
 		SetConsoleActiveScreenBuffer(m_hOriginalConsole);
 		delete[] m_bufScreen;
-		delete[] bufferPixels;
+#endif
 	}
 
 public:
 	void Start()
 	{
+		// ConstructConsole failed or was not called, there is nothing to show the game on
+		if (!m_bConsoleReady)
+			return;
+
 		m_bAtomActive = true;
 
 		// Star the thread
@@ -221,6 +322,52 @@ public:
 		t.join();
 	}
 
+	// Frames a stage may run ahead of the next one, call before Start. 0 updates, renders and presents
+	// each frame back to back on the game thread. Past that the update, the render thread of the context
+	// and the convert & present thread run side by side, 1 (the default) already overlaps all three,
+	// more absorbs uneven frames at the cost of latency.
+	void SetPipelineDepth(int frames)
+	{
+		m_nPipelineDepth = frames > 0 ? frames : 0;
+	}
+
+	// Frames per second the game loop is held to, 0 runs as fast as possible
+	void SetTargetFps(float fps)
+	{
+		m_fTargetFps = fps > 0.0f ? fps : 0.0f;
+	}
+
+	// Run OnFixedUpdate every seconds of game time, 0 (the default) never calls it
+	void SetFixedTimestep(float seconds)
+	{
+		m_fFixedTimestep = seconds > 0.0f ? seconds : 0.0f;
+	}
+
+	// Let the render resolution drop to fMinScale of the screen (per axis) while rendering takes longer than
+	// the target frame time, the frames are scaled back up to the screen. 1 (the default) always renders at
+	// full resolution. Needs a target frame rate and the pipeline.
+	void SetDynamicResolution(float fMinScale)
+	{
+		m_fMinResolutionScale = fMinScale < 1.0f ? max(fMinScale, 0.05f) : 1.0f;
+	}
+
+	// GL_NEAREST (the default) or GL_LINEAR, how lowered resolution frames are scaled up to the screen
+	void SetUpscaleFilter(int filter)
+	{
+		m_nUpscaleFilter = filter;
+	}
+
+	float GetResolutionScale()
+	{
+		return m_fResolutionScale;
+	}
+
+	// How far the frame is between the last fixed update and the next one, from 0 to 1
+	float GetFrameAlpha()
+	{
+		return m_fFrameAlpha;
+	}
+
 	int ScreenWidth()
 	{
 		return m_nScreenWidth;
@@ -234,26 +381,59 @@ public:
 private:
 	void GameThread()
 	{
-		glInit(this->m_nScreenWidth, this->m_nScreenHeight);
+#ifdef _WIN32
+		bool bContext = glInit(this->m_nScreenWidth, this->m_nScreenHeight);
+#else
+		bool bContext = glInit(m_vt.PixelWidth(), m_vt.PixelHeight());
+#endif
+		if (!bContext)
+		{
+			m_bAtomActive = false;
+			m_cvGameFinished.notify_one();
+			return;
+		}
+
+		// m_bufScreen keeps the previous frame, only what was drawn to is converted and written
+		glEnable(EXT_OLC_DIRTY_TILES);
+
+		// Large conversions are split across the cores
+		int nThreads = (int)thread::hardware_concurrency();
+		glPixelStorei(EXT_OLC_PACK_THREADS, nThreads > 0 ? nThreads : 1);
+
+#ifndef _WIN32
+		m_vt.Begin();
+		float fTitleTime = 1.0f;
+#endif
 
 		// Create user resources as part of this thread
 		if (!OnUserCreate())
 			m_bAtomActive = false;
 
-		auto tp1 = chrono::system_clock::now();
-		auto tp2 = chrono::system_clock::now();
+		if (m_bAtomActive && m_nPipelineDepth > 0)
+			StartPipeline();
+
+#ifdef _WIN32
+		// Sleeps wake up within a millisecond instead of a scheduler tick
+		timeBeginPeriod(1);
+#endif
+
+		auto tp1 = chrono::steady_clock::now();
+		auto tp2 = chrono::steady_clock::now();
+		m_tpNextFrame = tp1;
 
 		while (m_bAtomActive)
 		{
-			// Run as fast as possible
 			while (m_bAtomActive)
 			{
+				PaceFrame();
+
 				// Handle Timing
-				tp2 = chrono::system_clock::now();
+				tp2 = chrono::steady_clock::now();
 				chrono::duration<float> elapsedTime = tp2 - tp1;
 				tp1 = tp2;
 				float fElapsedTime = elapsedTime.count();
 
+#ifdef _WIN32
 				// Handle Keyboard Input
 				for (int i = 0; i < 256; i++)
 				{
@@ -328,6 +508,7 @@ private:
 						// We don't care just at the moment
 					}
 				}
+#endif
 
 				for (int m = 0; m < 5; m++)
 				{
@@ -351,32 +532,99 @@ private:
 					m_mouseOldState[m] = m_mouseNewState[m];
 				}
 
+				// Advance the simulation in fixed steps, the frame shows it m_fFrameAlpha of a step later
+				if (m_fFixedTimestep > 0.0f)
+				{
+					m_fAccumulator += fElapsedTime;
+					for (int nStep = 0; m_fAccumulator >= m_fFixedTimestep && m_bAtomActive; nStep++)
+					{
+						if (nStep == MAX_FIXED_STEPS)
+						{
+							m_fAccumulator = 0.0f;
+							break;
+						}
+
+						if (!OnFixedUpdate(m_fFixedTimestep))
+							m_bAtomActive = false;
+						m_fAccumulator -= m_fFixedTimestep;
+					}
+					m_fFrameAlpha = m_fAccumulator / m_fFixedTimestep;
+				}
+
+				if (m_nFrameSink != 0)
+					BeginFrame();
+
 				// Handle Frame Update
 				if (!OnUserUpdate(fElapsedTime))
 					m_bAtomActive = false;
 
-				// copy opengl output to console
-				glReadPixels(0, 0, m_nScreenWidth, m_nScreenHeight, EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL, bufferPixels);
-				for (int y = 0; y < m_nScreenHeight; y++) {
-					for (int x = 0; x < m_nScreenWidth; x++) {
-						OlcPixel* pixel = &bufferPixels[y * m_nScreenWidth + x];
-						Draw(x, y, pixel->c, pixel->col);
-					}
+				if (m_nFrameSink != 0)
+				{
+					SubmitFrame();
+					continue;
 				}
 
+#ifdef _WIN32
+				// read the opengl output straight into the console screen buffer
+				int dirtyRects[MAX_DIRTY_RECTS * 4];
+				int dirtyCount = glGetDirtyRectsEXT(MAX_DIRTY_RECTS, dirtyRects);
+
+				OlcCellLayoutEXT layout = { m_bufScreen, m_nScreenWidth * (int)sizeof(CHAR_INFO), sizeof(CHAR_INFO),
+					offsetof(CHAR_INFO, Char), sizeof(WCHAR), offsetof(CHAR_INFO, Attributes), sizeof(WORD) };
+				glReadCellsEXT(0, 0, m_nScreenWidth, m_nScreenHeight, &layout);
+
 				// Update Title & Present Screen Buffer
 				wchar_t s[256];
 				swprintf_s(s, 256, L"OneLoneCoder.com - Console Game Engine - %s - FPS: %3.2f - %d ", m_sAppName.c_str(), 1.0f / fElapsedTime, events);
 				SetConsoleTitle(s);
-				WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)m_nScreenWidth, (short)m_nScreenHeight }, { 0,0 }, &m_rectWindow);
+				if (dirtyCount > MAX_DIRTY_RECTS) {
+					WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)m_nScreenWidth, (short)m_nScreenHeight }, { 0,0 }, &m_rectWindow);
+				}
+				else {
+					for (int i = 0; i < dirtyCount; i++) {
+						int* rect = &dirtyRects[i * 4];
+						SMALL_RECT region = { (short)rect[0], (short)rect[1], (short)(rect[0] + rect[2] - 1), (short)(rect[1] + rect[3] - 1) };
+						WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)m_nScreenWidth, (short)m_nScreenHeight }, { (short)rect[0], (short)rect[1] }, &region);
+					}
+				}
+#else
+				// read the opengl output straight into the terminal's cells, only the ones that changed are sent
+				if (m_vt.Mode() == VT_CELLS)
+				{
+					OlcCellLayoutEXT layout = m_vt.Layout();
+					glReadCellsEXT(0, 0, m_nScreenWidth, m_nScreenHeight, &layout);
+				}
+				else
+				{
+					glReadPixels(0, 0, m_vt.PixelWidth(), m_vt.PixelHeight(), GL_RGBA, GL_BYTE, m_vt.Pixels());
+				}
+
+				// Update Title about once a second, it goes out with the frame & Present Screen Buffer
+				fTitleTime += fElapsedTime;
+				if (fTitleTime >= 1.0f)
+				{
+					const VTFrameStats& stats = m_vt.Stats();
+					wchar_t s[256];
+					swprintf(s, 256, L"OneLoneCoder.com - Console Game Engine - %ls - FPS: %3.2f - %zu bytes %d writes ", m_sAppName.c_str(), 1.0f / fElapsedTime, stats.bytes, stats.syscalls);
+					m_vt.SetTitle(s);
+					fTitleTime = 0.0f;
+				}
+				m_vt.Present();
+#endif
 			}
 
 			if (OnUserDestroy())
 			{
 				// User has permitted destroy, so exit and clean up
+				StopPipeline();
 
+#ifdef _WIN32
 				delete[] m_bufScreen;
 				SetConsoleActiveScreenBuffer(m_hOriginalConsole);
+#else
+				m_vt.End();
+#endif
+				glDestroyContextEXT(glGetCurrentContextEXT());
 				m_cvGameFinished.notify_one();
 			}
 			else
@@ -385,6 +633,303 @@ private:
 				m_bAtomActive = true;
 			}
 		}
+
+#ifdef _WIN32
+		// Also reached when OnUserCreate failed
+		timeEndPeriod(1);
+#endif
+	}
+
+	// Wait for the next frame's deadline, one that was missed by more than a frame is dropped rather than caught up on
+	void PaceFrame()
+	{
+		if (m_fTargetFps <= 0.0f)
+			return;
+
+		auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / m_fTargetFps));
+		auto now = chrono::steady_clock::now();
+		if (now < m_tpNextFrame)
+		{
+			SleepUntil(m_tpNextFrame);
+			m_tpNextFrame += period;
+		}
+		else if (now - m_tpNextFrame > period)
+			m_tpNextFrame = now + period;
+		else
+			m_tpNextFrame += period;
+	}
+
+	// Sleep a millisecond at a time while a sleep can not overshoot the deadline, then spin the rest.
+	// How long those sleeps really take is tracked as they happen.
+	void SleepUntil(chrono::steady_clock::time_point deadline)
+	{
+		while (true)
+		{
+			auto start = chrono::steady_clock::now();
+			double remaining = chrono::duration<double>(deadline - start).count();
+			if (remaining <= min(m_dSleepMean + 2.0 * sqrt(m_dSleepVar), MAX_SPIN_MICROSECONDS * 1e-6))
+				break;
+
+			this_thread::sleep_for(chrono::milliseconds(1));
+
+			double slept = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			double delta = slept - m_dSleepMean;
+			m_dSleepMean += 0.05 * delta;
+			m_dSleepVar = 0.95 * (m_dSleepVar + 0.05 * delta * delta);
+		}
+
+		while (chrono::steady_clock::now() < deadline)
+			this_thread::yield();
+	}
+
+	void StartPipeline()
+	{
+		// The render thread draws while the next frame is updated
+		glEnable(EXT_OLC_ASYNC);
+
+		// Frames are converted and presented on the sink's thread
+#ifdef _WIN32
+		m_nFrameSink = glCreateFrameCallbackEXT(EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL, m_nPipelineDepth, PresentFrame, this);
+#else
+		if (m_vt.Mode() == VT_CELLS)
+			m_nFrameSink = glCreateFrameCallbackEXT(EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL, m_nPipelineDepth, PresentFrame, this);
+		else
+			m_nFrameSink = glCreateFrameCallbackEXT(GL_RGBA, GL_BYTE, m_nPipelineDepth, PresentFrame, this);
+#endif
+		m_tpPresent = chrono::steady_clock::now();
+		m_fPresentTime = 1.0f;
+
+		// Frames of any resolution come out at the size of the screen
+#ifdef _WIN32
+		m_nFullWidth = m_nScreenWidth;
+		m_nFullHeight = m_nScreenHeight;
+#else
+		m_nFullWidth = m_vt.PixelWidth();
+		m_nFullHeight = m_vt.PixelHeight();
+#endif
+		glFrameSinkScaleEXT(m_nFrameSink, m_nFullWidth, m_nFullHeight, m_nUpscaleFilter);
+
+		// A query per frame in flight times the rendering of each frame
+		if (m_fMinResolutionScale < 1.0f)
+		{
+			m_vecFrameQueries.resize(m_nPipelineDepth + 2);
+			for (auto& frameQuery : m_vecFrameQueries)
+			{
+				glGenQueries(1, &frameQuery.id);
+				frameQuery.pending = false;
+			}
+		}
+	}
+
+	void BeginFrame()
+	{
+		if (m_vecFrameQueries.empty())
+			return;
+
+		if (m_fNextResolutionScale != m_fResolutionScale)
+		{
+			m_fResolutionScale = m_fNextResolutionScale;
+			int w = max(1, (int)(m_nFullWidth * m_fResolutionScale + 0.5f));
+			int h = max(1, (int)(m_nFullHeight * m_fResolutionScale + 0.5f));
+			glFramebufferSizeEXT(w, h);
+		}
+
+		sFrameQuery& frameQuery = m_vecFrameQueries[m_nFrame % m_vecFrameQueries.size()];
+		if (frameQuery.pending)
+			ReadFrameQuery(frameQuery, true);
+
+		glBeginQuery(GL_TIME_ELAPSED, frameQuery.id);
+		frameQuery.scale = m_fResolutionScale;
+		frameQuery.pending = true;
+	}
+
+	// Feed the render time of a finished frame to the resolution controller, false if it is not known yet
+	bool ReadFrameQuery(sFrameQuery& frameQuery, bool bWait)
+	{
+		unsigned long long available = 1;
+		if (!bWait)
+			glGetQueryObjectui64v(frameQuery.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+
+		unsigned long long nanoseconds;
+		glGetQueryObjectui64v(frameQuery.id, GL_QUERY_RESULT, &nanoseconds);
+		frameQuery.pending = false;
+
+		// Frames rendered before the last change say nothing about the current resolution
+		if (frameQuery.scale == m_fResolutionScale && m_fNextResolutionScale == m_fResolutionScale)
+			UpdateResolution(nanoseconds * 1e-9f);
+		return true;
+	}
+
+	/*
+	Render cost is about proportional to the pixel count, so the scale that brings the cost to the middle of the
+	band between the low and high marks is the current one times the square root of their ratio. Dropping
+	happens after a few slow frames, going back up only after many fast ones and by a bounded step.
+	*/
+	void UpdateResolution(float fCost)
+	{
+		if (m_fTargetFps <= 0.0f)
+			return;
+
+		const float fBudget = 1.0f / m_fTargetFps;
+		const float fHigh = 0.9f * fBudget;
+		const float fLow = 0.6f * fBudget;
+
+		m_fRenderCost = m_fRenderCost == 0.0f ? fCost : 0.8f * m_fRenderCost + 0.2f * fCost;
+		m_nOverBudget = m_fRenderCost > fHigh ? m_nOverBudget + 1 : 0;
+		m_nUnderBudget = m_fRenderCost < fLow ? m_nUnderBudget + 1 : 0;
+
+		float fScale = m_fResolutionScale;
+		if (m_nOverBudget >= DYNRES_DOWN_FRAMES && fScale > m_fMinResolutionScale)
+			fScale = max(m_fMinResolutionScale, fScale * sqrt(0.5f * (fHigh + fLow) / m_fRenderCost));
+		else if (m_nUnderBudget >= DYNRES_UP_FRAMES && fScale < 1.0f)
+			fScale = min(1.0f, fScale * min(1.25f, sqrt(0.5f * (fHigh + fLow) / m_fRenderCost)));
+		else
+			return;
+
+		m_fNextResolutionScale = fScale;
+		m_fRenderCost = 0.0f;
+		m_nOverBudget = 0;
+		m_nUnderBudget = 0;
+	}
+
+	void SubmitFrame()
+	{
+		if (!m_vecFrameQueries.empty())
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+
+			// Oldest first, each frame finishes after the one before it
+			for (size_t i = 1; i <= m_vecFrameQueries.size(); i++)
+			{
+				sFrameQuery& frameQuery = m_vecFrameQueries[(m_nFrame + i) % m_vecFrameQueries.size()];
+				if (frameQuery.pending && !ReadFrameQuery(frameQuery, false))
+					break;
+			}
+			m_nFrame++;
+		}
+
+		glWriteFrameEXT(m_nFrameSink);
+
+		// Hold the update back once it is too far ahead of the render thread
+		m_listFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		if ((int)m_listFences.size() > m_nPipelineDepth)
+		{
+			glClientWaitSync(m_listFences.front(), 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(m_listFences.front());
+			m_listFences.pop_front();
+		}
+	}
+
+	// Presents the frames still queued
+	void StopPipeline()
+	{
+		if (m_nFrameSink == 0)
+			return;
+
+		for (auto sync : m_listFences)
+			glDeleteSync(sync);
+		m_listFences.clear();
+
+		for (auto& frameQuery : m_vecFrameQueries)
+			glDeleteQueries(1, &frameQuery.id);
+		m_vecFrameQueries.clear();
+
+		glDeleteFrameSinkEXT(m_nFrameSink);
+		m_nFrameSink = 0;
+		glDisable(EXT_OLC_ASYNC);
+	}
+
+	static void PresentFrame(void* user, const void* data, int w, int h, const int* rects, int rectCount)
+	{
+		((olcConsoleGameEngine*)user)->Present(data, w, h, rects, rectCount);
+	}
+
+	// Runs on the frame sink's thread, only the rects changed since the last frame
+	void Present(const void* data, int w, int h, const int* rects, int rectCount)
+	{
+		auto tp = chrono::steady_clock::now();
+		chrono::duration<float> elapsedTime = tp - m_tpPresent;
+		m_tpPresent = tp;
+		float fElapsedTime = elapsedTime.count();
+
+#ifdef _WIN32
+		if (w != m_nScreenWidth || h != m_nScreenHeight)
+			return;
+
+		const OlcPixel* cells = (const OlcPixel*)data;
+		for (int i = 0; i < rectCount; i++)
+		{
+			const int* rect = &rects[i * 4];
+			for (int y = rect[1]; y < rect[1] + rect[3]; y++)
+			{
+				for (int x = rect[0]; x < rect[0] + rect[2]; x++)
+				{
+					m_bufScreen[y * w + x].Char.UnicodeChar = cells[y * w + x].c;
+					m_bufScreen[y * w + x].Attributes = cells[y * w + x].col;
+				}
+			}
+		}
+
+		m_fPresentTime += fElapsedTime;
+		if (m_fPresentTime >= 1.0f)
+		{
+			wchar_t s[256];
+			swprintf_s(s, 256, L"OneLoneCoder.com - Console Game Engine - %s - FPS: %3.2f ", m_sAppName.c_str(), 1.0f / fElapsedTime);
+			SetConsoleTitle(s);
+			m_fPresentTime = 0.0f;
+		}
+
+		if (rectCount > MAX_DIRTY_RECTS)
+		{
+			WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)w, (short)h }, { 0,0 }, &m_rectWindow);
+		}
+		else
+		{
+			for (int i = 0; i < rectCount; i++)
+			{
+				const int* rect = &rects[i * 4];
+				SMALL_RECT region = { (short)rect[0], (short)rect[1], (short)(rect[0] + rect[2] - 1), (short)(rect[1] + rect[3] - 1) };
+				WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)w, (short)h }, { (short)rect[0], (short)rect[1] }, &region);
+			}
+		}
+#else
+		if (w != m_vt.PixelWidth() || h != m_vt.PixelHeight())
+			return;
+
+		for (int i = 0; i < rectCount; i++)
+		{
+			const int* rect = &rects[i * 4];
+			for (int y = rect[1]; y < rect[1] + rect[3]; y++)
+			{
+				if (m_vt.Mode() == VT_CELLS)
+				{
+					const OlcPixel* cells = (const OlcPixel*)data + y * w;
+					for (int x = rect[0]; x < rect[0] + rect[2]; x++)
+					{
+						m_bufScreen[y * w + x].ch = (unsigned int)cells[x].c;
+						m_bufScreen[y * w + x].attr = cells[x].col;
+					}
+				}
+				else
+				{
+					memcpy((unsigned char*)m_vt.Pixels() + ((size_t)y * w + rect[0]) * 4, (const unsigned char*)data + ((size_t)y * w + rect[0]) * 4, (size_t)rect[2] * 4);
+				}
+			}
+		}
+
+		m_fPresentTime += fElapsedTime;
+		if (m_fPresentTime >= 1.0f)
+		{
+			const VTFrameStats& stats = m_vt.Stats();
+			wchar_t s[256];
+			swprintf(s, 256, L"OneLoneCoder.com - Console Game Engine - %ls - FPS: %3.2f - %zu bytes %d writes ", m_sAppName.c_str(), 1.0f / fElapsedTime, stats.bytes, stats.syscalls);
+			m_vt.SetTitle(s);
+			m_fPresentTime = 0.0f;
+		}
+		m_vt.Present();
+#endif
 	}
 
 public:
@@ -392,6 +937,12 @@ public:
 	virtual bool OnUserCreate() = 0;
 	virtual bool OnUserUpdate(float fElapsedTime) = 0;
 
+	// Optional simulation step, see SetFixedTimestep
+	virtual bool OnFixedUpdate(float)
+	{
+		return true;
+	}
+
 	// Optional for clean up 
 	virtual bool OnUserDestroy()
 	{
@@ -421,6 +972,7 @@ public:
 
 
 protected:
+#ifdef _WIN32
 	int Error(const wchar_t *msg)
 	{
 		wchar_t buf[256];
@@ -445,27 +997,71 @@ protected:
 		}
 		return true;
 	}
+#else
+	int Error(const wchar_t *msg)
+	{
+		// None of the failures here come from a system call, errno has nothing to add
+		fwprintf(stderr, L"ERROR: %ls\n", msg);
+		return 0;
+	}
+
+	static void InterruptHandler(int)
+	{
+		m_bAtomActive = false;
+	}
+#endif
 
 protected:
 	int m_nScreenWidth;
 	int m_nScreenHeight;
+#ifdef _WIN32
 	CHAR_INFO *m_bufScreen;
+#else
+	VTCell *m_bufScreen;
+	VTConsole m_vt;
+#endif
 	wstring m_sAppName;
+#ifdef _WIN32
 	HANDLE m_hOriginalConsole;
 	CONSOLE_SCREEN_BUFFER_INFO m_OriginalConsoleInfo;
 	HANDLE m_hConsole;
 	HANDLE m_hConsoleIn;
 	SMALL_RECT m_rectWindow;
+#endif
 	short m_keyOldState[256] = { 0 };
 	short m_keyNewState[256] = { 0 };
 	bool m_mouseOldState[5] = { 0 };
 	bool m_mouseNewState[5] = { 0 };
 	bool m_bConsoleInFocus = true;
+	bool m_bConsoleReady = false;
+	int m_nPipelineDepth;
+	int m_nFrameSink;
+	list<int> m_listFences;
+	chrono::steady_clock::time_point m_tpPresent;
+	float m_fPresentTime;
+	float m_fTargetFps;
+	float m_fFixedTimestep;
+	float m_fAccumulator;
+	float m_fFrameAlpha;
+	chrono::steady_clock::time_point m_tpNextFrame;
+	double m_dSleepMean;
+	double m_dSleepVar;
+	vector<sFrameQuery> m_vecFrameQueries;
+	int m_nFrame;
+	int m_nFullWidth;
+	int m_nFullHeight;
+	float m_fMinResolutionScale;
+	float m_fResolutionScale;
+	float m_fNextResolutionScale;
+	int m_nUpscaleFilter;
+	float m_fRenderCost;
+	int m_nOverBudget;
+	int m_nUnderBudget;
 	static atomic<bool> m_bAtomActive;
 	static condition_variable m_cvGameFinished;
 	static mutex m_muxGame;
 };
 
-atomic<bool> olcConsoleGameEngine::m_bAtomActive = false;
+atomic<bool> olcConsoleGameEngine::m_bAtomActive(false);
 condition_variable olcConsoleGameEngine::m_cvGameFinished;
 mutex olcConsoleGameEngine::m_muxGame;
\ No newline at end of file
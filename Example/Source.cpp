@@ -3,13 +3,13 @@
 #define HEIGHT 200
 #define WIDTH 200
 
-float grassTexture[] = { 0.451, 0.686, 0.282, 1.000, 0.451, 0.686, 0.282, 1.000, 0.451, 0.686, 0.282, 1.000, 0.376, 0.627, 0.220, 1.000, 0.388, 0.643, 0.231, 1.000, 0.427, 0.675, 0.271, 1.000, 0.345, 0.612, 0.188, 1.000, 0.427, 0.675, 0.271, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.408, 0.659, 0.251, 1.000, 0.408, 0.659, 0.251, 1.000, 0.420, 0.663, 0.263, 1.000, 0.345, 0.596, 0.188, 1.000, 0.345, 0.596, 0.188, 1.000, 0.420, 0.663, 0.263, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.408, 0.659, 0.251, 1.000, 0.408, 0.659, 0.251, 1.000, 0.408, 0.659, 0.251, 1.000, 0.408, 0.659, 0.251, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.420, 0.580, 0.251, 1.000, 0.420, 0.580, 0.251, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.506, 0.200, 1.000, 0.376, 0.643, 0.220, 1.000, 0.690, 0.518, 0.376, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.659, 0.518, 0.376, 1.000, 0.553, 0.424, 0.302, 1.000, 0.553, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.451, 0.686, 0.282, 1.000, 0.451, 0.686, 0.282, 1.000, 0.522, 0.741, 0.345, 1.000, 0.451, 0.686, 0.282, 1.000, 0.471, 0.706, 0.314, 1.000, 0.345, 0.612, 0.188, 1.000, 0.388, 0.643, 0.231, 1.000, 0.388, 0.643, 0.231, 1.000, 0.345, 0.612, 0.188, 1.000, 0.533, 0.753, 0.376, 1.000, 0.533, 0.753, 0.376, 1.000, 0.471, 0.706, 0.314, 1.000, 0.345, 0.596, 0.188, 1.000, 0.420, 0.663, 0.263, 1.000, 0.420, 0.663, 0.263, 1.000, 0.420, 0.663, 0.263, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.408, 0.659, 0.251, 1.000, 0.345, 0.235, 0.157, 1.000, 0.408, 0.659, 0.251, 1.000, 0.408, 0.659, 0.251, 1.000, 0.420, 0.580, 0.251, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.643, 0.220, 1.000, 0.459, 0.329, 0.231, 1.000, 0.576, 0.424, 0.302, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.659, 0.518, 0.376, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.522, 0.741, 0.345, 1.000, 0.596, 0.800, 0.408, 1.000, 0.596, 0.800, 0.408, 1.000, 0.376, 0.627, 0.220, 1.000, 0.388, 0.643, 0.231, 1.000, 0.388, 0.643, 0.231, 1.000, 0.427, 0.675, 0.271, 1.000, 0.427, 0.675, 0.271, 1.000, 0.471, 0.706, 0.314, 1.000, 0.533, 0.753, 0.376, 1.000, 0.533, 0.753, 0.376, 1.000, 0.533, 0.753, 0.376, 1.000, 0.420, 0.663, 0.263, 1.000, 0.345, 0.596, 0.188, 1.000, 0.345, 0.596, 0.188, 1.000, 0.565, 0.800, 0.408, 1.000, 0.471, 0.706, 0.314, 1.000, 0.345, 0.235, 0.188, 1.000, 0.471, 0.706, 0.314, 1.000, 0.471, 0.706, 0.314, 1.000, 0.408, 0.659, 0.251, 1.000, 0.345, 0.235, 0.157, 1.000, 0.408, 0.659, 0.251, 1.000, 0.345, 0.235, 0.157, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.471, 0.737, 0.314, 1.000, 0.376, 0.235, 0.157, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.643, 0.220, 1.000, 0.376, 0.235, 0.157, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.451, 0.686, 0.282, 1.000, 0.427, 0.675, 0.271, 1.000, 0.471, 0.706, 0.314, 1.000, 0.345, 0.612, 0.188, 1.000, 0.345, 0.612, 0.188, 1.000, 0.345, 0.612, 0.188, 1.000, 0.345, 0.612, 0.188, 1.000, 0.408, 0.659, 0.251, 1.000, 0.471, 0.706, 0.314, 1.000, 0.420, 0.663, 0.263, 1.000, 0.420, 0.663, 0.263, 1.000, 0.420, 0.663, 0.263, 1.000, 0.345, 0.596, 0.188, 1.000, 0.345, 0.235, 0.188, 1.000, 0.388, 0.392, 0.231, 1.000, 0.345, 0.235, 0.188, 1.000, 0.345, 0.235, 0.188, 1.000, 0.408, 0.659, 0.251, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.420, 0.580, 0.251, 1.000, 0.314, 0.267, 0.125, 1.000, 0.471, 0.737, 0.314, 1.000, 0.314, 0.267, 0.125, 1.000, 0.376, 0.373, 0.176, 1.000, 0.376, 0.235, 0.157, 1.000, 0.376, 0.235, 0.157, 1.000, 0.376, 0.373, 0.176, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.345, 0.235, 0.157, 1.000, 0.451, 0.329, 0.231, 1.000, 0.659, 0.518, 0.376, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.533, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.596, 0.784, 0.408, 1.000, 0.282, 0.565, 0.125, 1.000, 0.388, 0.639, 0.220, 1.000, 0.490, 0.710, 0.314, 1.000, 0.565, 0.753, 0.376, 1.000, 0.345, 0.612, 0.188, 1.000, 0.420, 0.659, 0.251, 1.000, 0.420, 0.659, 0.251, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.125, 1.000, 0.553, 0.424, 0.314, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.125, 1.000, 0.553, 0.424, 0.314, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.576, 0.424, 0.302, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.482, 0.710, 0.325, 1.000, 0.482, 0.710, 0.325, 1.000, 0.376, 0.627, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.482, 0.710, 0.325, 1.000, 0.482, 0.710, 0.325, 1.000, 0.482, 0.710, 0.325, 1.000, 0.388, 0.639, 0.220, 1.000, 0.490, 0.710, 0.314, 1.000, 0.388, 0.639, 0.220, 1.000, 0.388, 0.639, 0.220, 1.000, 0.345, 0.612, 0.188, 1.000, 0.420, 0.659, 0.251, 1.000, 0.420, 0.659, 0.251, 1.000, 0.490, 0.706, 0.314, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.451, 0.329, 0.220, 1.000, 0.553, 0.424, 0.314, 1.000, 0.345, 0.235, 0.125, 1.000, 0.345, 0.235, 0.125, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.451, 0.329, 0.220, 1.000, 0.553, 0.424, 0.314, 1.000, 0.345, 0.235, 0.125, 1.000, 0.345, 0.235, 0.125, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.376, 0.627, 0.220, 1.000, 0.482, 0.710, 0.325, 1.000, 0.533, 0.753, 0.376, 1.000, 0.427, 0.671, 0.271, 1.000, 0.427, 0.671, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.427, 0.671, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.388, 0.639, 0.220, 1.000, 0.388, 0.639, 0.220, 1.000, 0.596, 0.784, 0.408, 1.000, 0.596, 0.784, 0.408, 1.000, 0.420, 0.659, 0.251, 1.000, 0.565, 0.753, 0.376, 1.000, 0.490, 0.706, 0.314, 1.000, 0.420, 0.659, 0.251, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.659, 0.518, 0.408, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.659, 0.518, 0.408, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.690, 0.518, 0.376, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.659, 0.518, 0.408, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.659, 0.518, 0.408, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.690, 0.518, 0.376, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.427, 0.671, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.482, 0.710, 0.325, 1.000, 0.427, 0.671, 0.271, 1.000, 0.427, 0.671, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.533, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.490, 0.710, 0.314, 1.000, 0.596, 0.784, 0.408, 1.000, 0.388, 0.639, 0.220, 1.000, 0.388, 0.639, 0.220, 1.000, 0.420, 0.659, 0.251, 1.000, 0.490, 0.706, 0.314, 1.000, 0.345, 0.612, 0.188, 1.000, 0.565, 0.753, 0.376, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.553, 0.424, 0.314, 1.000, 0.553, 0.424, 0.314, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.576, 0.424, 0.302, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.553, 0.424, 0.314, 1.000, 0.553, 0.424, 0.314, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.576, 0.424, 0.302, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.408, 0.643, 0.220, 1.000, 0.482, 0.694, 0.294, 1.000, 0.627, 0.800, 0.439, 1.000, 0.553, 0.749, 0.365, 1.000, 0.565, 0.769, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.565, 0.769, 0.376, 1.000, 0.502, 0.722, 0.325, 1.000, 0.533, 0.769, 0.376, 1.000, 0.533, 0.769, 0.376, 1.000, 0.345, 0.612, 0.188, 1.000, 0.439, 0.690, 0.282, 1.000, 0.376, 0.627, 0.220, 1.000, 0.439, 0.675, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.451, 0.329, 0.231, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.231, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.451, 0.329, 0.231, 1.000, 0.482, 0.694, 0.294, 1.000, 0.408, 0.643, 0.220, 1.000, 0.627, 0.800, 0.439, 1.000, 0.408, 0.643, 0.220, 1.000, 0.439, 0.675, 0.271, 1.000, 0.439, 0.675, 0.271, 1.000, 0.565, 0.769, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.345, 0.612, 0.188, 1.000, 0.439, 0.690, 0.282, 1.000, 0.439, 0.690, 0.282, 1.000, 0.533, 0.769, 0.376, 1.000, 0.439, 0.675, 0.271, 1.000, 0.565, 0.769, 0.376, 1.000, 0.439, 0.675, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.659, 0.518, 0.376, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.459, 0.329, 0.231, 1.000, 0.659, 0.518, 0.376, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.482, 0.694, 0.294, 1.000, 0.482, 0.694, 0.294, 1.000, 0.482, 0.694, 0.294, 1.000, 0.553, 0.749, 0.365, 1.000, 0.376, 0.627, 0.220, 1.000, 0.565, 0.769, 0.376, 1.000, 0.439, 0.675, 0.271, 1.000, 0.439, 0.675, 0.271, 1.000, 0.627, 0.847, 0.471, 1.000, 0.345, 0.612, 0.188, 1.000, 0.533, 0.769, 0.376, 1.000, 0.345, 0.612, 0.188, 1.000, 0.439, 0.675, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.439, 0.675, 0.271, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.376, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.553, 0.424, 0.302, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.376, 1.000, 0.690, 0.518, 0.376, 1.000, 0.459, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.553, 0.424, 0.302, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.408, 0.643, 0.220, 1.000, 0.553, 0.749, 0.365, 1.000, 0.408, 0.643, 0.220, 1.000, 0.553, 0.749, 0.365, 1.000, 0.502, 0.722, 0.325, 1.000, 0.376, 0.627, 0.220, 1.000, 0.439, 0.675, 0.271, 1.000, 0.439, 0.675, 0.271, 1.000, 0.439, 0.690, 0.282, 1.000, 0.439, 0.690, 0.282, 1.000, 0.439, 0.690, 0.282, 1.000, 0.345, 0.612, 0.188, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.439, 0.675, 0.271, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.553, 0.424, 0.302, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.576, 0.424, 0.302, 1.000, 0.459, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.553, 0.424, 0.302, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.596, 0.800, 0.408, 1.000, 0.502, 0.725, 0.325, 1.000, 0.408, 0.655, 0.239, 1.000, 0.408, 0.655, 0.239, 1.000, 0.459, 0.694, 0.282, 1.000, 0.459, 0.694, 0.282, 1.000, 0.376, 0.627, 0.188, 1.000, 0.376, 0.627, 0.188, 1.000, 0.251, 0.518, 0.094, 1.000, 0.502, 0.725, 0.325, 1.000, 0.376, 0.624, 0.208, 1.000, 0.376, 0.624, 0.208, 1.000, 0.502, 0.710, 0.325, 1.000, 0.565, 0.753, 0.376, 1.000, 0.376, 0.627, 0.220, 1.000, 0.376, 0.627, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.553, 0.424, 0.302, 1.000, 0.553, 0.424, 0.302, 1.000, 0.659, 0.518, 0.376, 1.000, 0.451, 0.329, 0.231, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.553, 0.424, 0.314, 1.000, 0.553, 0.424, 0.314, 1.000, 0.659, 0.518, 0.408, 1.000, 0.451, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.690, 0.518, 0.345, 1.000, 0.596, 0.800, 0.408, 1.000, 0.502, 0.725, 0.325, 1.000, 0.314, 0.580, 0.157, 1.000, 0.314, 0.580, 0.157, 1.000, 0.376, 0.627, 0.188, 1.000, 0.376, 0.627, 0.188, 1.000, 0.376, 0.627, 0.188, 1.000, 0.627, 0.831, 0.471, 1.000, 0.502, 0.725, 0.325, 1.000, 0.627, 0.831, 0.439, 1.000, 0.502, 0.725, 0.325, 1.000, 0.502, 0.725, 0.325, 1.000, 0.502, 0.710, 0.325, 1.000, 0.376, 0.627, 0.220, 1.000, 0.565, 0.753, 0.376, 1.000, 0.565, 0.753, 0.376, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.451, 0.329, 0.231, 1.000, 0.553, 0.424, 0.302, 1.000, 0.553, 0.424, 0.302, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.451, 0.329, 0.220, 1.000, 0.553, 0.424, 0.314, 1.000, 0.553, 0.424, 0.314, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.345, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.502, 0.725, 0.325, 1.000, 0.502, 0.725, 0.325, 1.000, 0.408, 0.655, 0.239, 1.000, 0.314, 0.580, 0.157, 1.000, 0.545, 0.765, 0.376, 1.000, 0.545, 0.765, 0.376, 1.000, 0.459, 0.694, 0.282, 1.000, 0.459, 0.694, 0.282, 1.000, 0.376, 0.624, 0.208, 1.000, 0.502, 0.725, 0.325, 1.000, 0.502, 0.725, 0.325, 1.000, 0.376, 0.624, 0.208, 1.000, 0.565, 0.753, 0.376, 1.000, 0.502, 0.710, 0.325, 1.000, 0.439, 0.671, 0.271, 1.000, 0.502, 0.710, 0.325, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.345, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.451, 0.329, 0.231, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.690, 0.518, 0.345, 1.000, 0.451, 0.329, 0.220, 1.000, 0.345, 0.235, 0.125, 1.000, 0.451, 0.329, 0.220, 1.000, 0.345, 0.235, 0.125, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.408, 0.655, 0.239, 1.000, 0.502, 0.725, 0.325, 1.000, 0.408, 0.655, 0.239, 1.000, 0.314, 0.580, 0.157, 1.000, 0.545, 0.765, 0.376, 1.000, 0.459, 0.694, 0.282, 1.000, 0.459, 0.694, 0.282, 1.000, 0.627, 0.831, 0.471, 1.000, 0.376, 0.624, 0.208, 1.000, 0.627, 0.831, 0.439, 1.000, 0.376, 0.624, 0.208, 1.000, 0.376, 0.624, 0.208, 1.000, 0.376, 0.627, 0.220, 1.000, 0.439, 0.671, 0.271, 1.000, 0.376, 0.627, 0.220, 1.000, 0.502, 0.710, 0.325, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.553, 0.424, 0.302, 1.000, 0.451, 0.329, 0.231, 1.000, 0.659, 0.518, 0.376, 1.000, 0.553, 0.424, 0.302, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.690, 0.518, 0.345, 1.000, 0.576, 0.424, 0.282, 1.000, 0.553, 0.424, 0.314, 1.000, 0.451, 0.329, 0.220, 1.000, 0.659, 0.518, 0.408, 1.000, 0.553, 0.424, 0.314, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.459, 0.329, 0.220, 1.000, 0.576, 0.424, 0.282, 1.000, 0.576, 0.424, 0.282, 1.000, 0.459, 0.329, 0.220, 1.000, 0.345, 0.235, 0.157, 1.000 };
-
 class MyEngineClass : public olcConsoleGameEngine {
 	float t = 0;
 	int tid;
 
 	virtual bool OnUserCreate() {
+		// Only console cells are ever read back
+		glFramebufferFormatEXT(EXT_OLC_PIXEL_FORMAT, GL_DEPTH_COMPONENT16);
 
 		glEnable(GL_TEXTURE_2D);
 		glEnable(GL_DEPTH_TEST);
@@ -20,7 +20,7 @@ class MyEngineClass : public olcConsoleGameEngine {
 
 		glGenTextures(1, &tid);
 		glBindTexture(GL_TEXTURE_2D, tid);
-		glTexImage2D(GL_TEXTURE_2D, 48, 16, GL_FLOAT, grassTexture);
+		glTexImage2DFileEXT(GL_TEXTURE_2D, "grass.tga");
 		
 		glMatrixMode(GL_PROJECTION);
 		glLoadIdentity();
@@ -129,6 +129,8 @@ class MyEngineClass : public olcConsoleGameEngine {
 
 int main() {
 	MyEngineClass engine;
-	engine.ConstructConsole(WIDTH, HEIGHT, 4, 4);
+	if (!engine.ConstructConsole(WIDTH, HEIGHT, 4, 4))
+		return 1;
+
 	engine.Start();
 }
\ No newline at end of file
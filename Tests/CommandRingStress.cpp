@@ -0,0 +1,142 @@
+/*
+Stresses the command ring of EXT_OLC_ASYNC with the app thread as producer and the render thread as
+consumer. Frames of different sizes are recorded back to back without waiting for them:
+
+	- the command counts vary from frame to frame, so the ring wraps at every offset and the three
+	  slots of glLookAt straddle its end now and then
+	- every third frame records several times GL_RING_SIZE commands, the app thread has to block on
+	  the full ring until the render thread frees slots
+	- a fence follows every frame, older fences are polled, some are waited on with a short timeout
+	  and some with GL_TIMEOUT_IGNORED, and a fence must never be signaled before an older one
+
+Every frame goes to a callback sink, its hash has to match the same frame drawn synchronously. Prints
+what went wrong and returns non-zero if anything did. Meant to be run under TSAN as well:
+
+	g++ -std=c++14 -O1 -g -I../ConsoleGL -I../glm CommandRingStress.cpp ../ConsoleGL/GL.cpp -lpthread
+	g++ -std=c++14 -O1 -g -fsanitize=thread -I../ConsoleGL -I../glm CommandRingStress.cpp ../ConsoleGL/GL.cpp -lpthread
+*/
+
+#include "Scene.h"
+#include <cstdio>
+#include <deque>
+#include <mutex>
+
+#define WIDTH 160
+#define HEIGHT 100
+#define FRAMES 60
+#define ROUNDS 3
+// Fences polled after every frame
+#define FENCES 8
+
+std::mutex hashesMutex;
+std::vector<unsigned long long> hashes;
+
+void onFrame(void*, const void* data, int w, int h, const int*, int) {
+	const unsigned char* pixels = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ull;
+	for (int i = 0; i < w * h * 4; i++) {
+		hash ^= pixels[i];
+		hash *= 1099511628211ull;
+	}
+
+	std::lock_guard<std::mutex> lock(hashesMutex);
+	hashes.push_back(hash);
+}
+
+void drawFrame(int frame) {
+	if (frame % 3 == 0) {
+		// Around 48k commands, three times the ring
+		drawGrid(12000, frame / (float)FRAMES);
+	}
+	else if (frame % 3 == 1) {
+		drawGrid(100 + frame * 397 % 4000, frame / (float)FRAMES);
+	}
+	else {
+		setupScene();
+		drawScene(frame * 7.0f);
+	}
+}
+
+bool signaled(int status) {
+	return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+int main() {
+	int failures = 0;
+
+	glInit(WIDTH, HEIGHT);
+	setupScene();
+	std::vector<unsigned long long> expected;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		drawFrame(frame);
+		expected.push_back(hashFrame(WIDTH, HEIGHT));
+	}
+
+	glEnable(EXT_OLC_ASYNC);
+	int sink = glCreateFrameCallbackEXT(GL_RGBA, GL_BYTE, 4, onFrame, nullptr);
+
+	for (int round = 0; round < ROUNDS; round++) {
+		std::deque<int> fences;
+		// Index in fences of the newest fence seen signaled, older ones must be signaled too
+		int newestSignaled = -1;
+
+		setupScene();
+		for (int frame = 0; frame < FRAMES; frame++) {
+			drawFrame(frame);
+			glWriteFrameEXT(sink);
+
+			fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+			if (fences.size() > FENCES) {
+				glDeleteSync(fences.front());
+				fences.pop_front();
+				newestSignaled--;
+			}
+
+			int status;
+			if (frame % 5 == 0) status = glClientWaitSync(fences.back(), GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			else if (frame % 7 == 0) status = glClientWaitSync(fences.back(), GL_SYNC_FLUSH_COMMANDS_BIT, 100000);
+			else status = glClientWaitSync(fences.back(), 0, 0);
+
+			if (status == GL_WAIT_FAILED || (frame % 5 == 0 && !signaled(status))) {
+				printf("round %d, frame %d: wait returned %x\n", round, frame, status);
+				failures++;
+			}
+			if (signaled(status)) newestSignaled = (int)fences.size() - 1;
+
+			for (int i = 0; i < (int)fences.size(); i++) {
+				status = glClientWaitSync(fences[i], 0, 0);
+				if (i <= newestSignaled && status != GL_ALREADY_SIGNALED) {
+					printf("round %d, frame %d: fence %d is not signaled after a newer one\n", round, frame, i);
+					failures++;
+				}
+				if (signaled(status) && i > newestSignaled) newestSignaled = i;
+			}
+		}
+
+		glFinish();
+		for (size_t i = 0; i < fences.size(); i++) {
+			glDeleteSync(fences[i]);
+		}
+	}
+
+	glDeleteFrameSinkEXT(sink);
+
+	if (hashes.size() != FRAMES * ROUNDS) {
+		printf("%d frames written, %zu arrived\n", FRAMES * ROUNDS, hashes.size());
+		failures++;
+	}
+	for (size_t i = 0; i < hashes.size(); i++) {
+		if (hashes[i] != expected[i % FRAMES]) {
+			printf("round %zu, frame %zu differs from the synchronous one\n", i / FRAMES, i % FRAMES);
+			failures++;
+		}
+	}
+	if (glGetError() != GL_NO_ERROR) {
+		printf("unexpected GL error\n");
+		failures++;
+	}
+
+	glDestroyContextEXT(glGetCurrentContextEXT());
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,86 @@
+/*
+Measures how the conversion of a synchronous glReadPixels scales with EXT_OLC_PACK_THREADS. A frame is
+read as EXT_OLC_PIXEL, EXT_OLC_PIXEL_DITHERED and GL_RGBA GL_BYTE with 1, 2, 4 and 8 threads, the median
+time of the reads and the speedup over 1 thread are printed, and every result is checked against the
+one of 1 thread.
+
+The numbers only mean something on a machine with at least as many idle cores as threads, the core
+count is printed first. Optional arguments are the framebuffer size (default 400 x 200) and the reads
+per measurement (default 200):
+
+	g++ -std=c++14 -O2 -I../ConsoleGL -I../glm ConvertScaling.cpp ../ConsoleGL/GL.cpp -lpthread
+	./a.out 800 400 100
+*/
+
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+struct Read {
+	const char* name;
+	int format;
+	int type;
+	int pixelSize;
+};
+
+int main(int argc, char** argv) {
+	static const Read reads[] = {
+		{ "EXT_OLC_PIXEL", EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL, sizeof(OlcPixel) },
+		{ "EXT_OLC_PIXEL_DITHERED", EXT_OLC_PIXEL_FORMAT, EXT_OLC_PIXEL_DITHERED, sizeof(OlcPixel) },
+		{ "GL_RGBA GL_BYTE", GL_RGBA, GL_BYTE, 4 },
+	};
+	static const int threadCounts[] = { 1, 2, 4, 8 };
+
+	int w = argc > 2 ? atoi(argv[1]) : 400;
+	int h = argc > 2 ? atoi(argv[2]) : 200;
+	int count = argc > 3 ? atoi(argv[3]) : 200;
+	if (w <= 0 || h <= 0 || count <= 0) {
+		printf("usage: %s [width height [reads]]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%u hardware threads, %d x %d, median of %d reads\n", std::thread::hardware_concurrency(), w, h, count);
+
+	glInit(w, h);
+	setupScene();
+	drawScene(30.0f);
+
+	int mismatches = 0;
+	for (int r = 0; r < sizeof(reads) / sizeof(reads[0]); r++) {
+		const Read& read = reads[r];
+		std::vector<unsigned char> expected((size_t)w * h * read.pixelSize);
+		std::vector<unsigned char> result(expected.size());
+		std::vector<double> times(count);
+		double single = 0;
+
+		printf("\n%s\n", read.name);
+		for (int t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+			glPixelStorei(EXT_OLC_PACK_THREADS, threadCounts[t]);
+
+			for (int i = 0; i < count; i++) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				glReadPixels(0, 0, w, h, read.format, read.type, result.data());
+				times[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			}
+			std::sort(times.begin(), times.end());
+			double median = times[count / 2];
+
+			if (t == 0) {
+				expected = result;
+				single = median;
+			}
+			else if (result != expected) {
+				printf("  %d threads: result differs from 1 thread\n", threadCounts[t]);
+				mismatches++;
+			}
+			printf("  %d threads: %8.1f us  %.2fx\n", threadCounts[t], median, single / median);
+		}
+	}
+
+	glPixelStorei(EXT_OLC_PACK_THREADS, 1);
+	return mismatches != 0 || glGetError() != GL_NO_ERROR;
+}
@@ -0,0 +1,105 @@
+/*
+Checks that glReadPixels into a pixel pack buffer gives the same bytes as the synchronous path. Every
+framebuffer format is read in several pixel formats, with regions partly outside the framebuffer and an
+offset into the buffer. Three reads are in flight and the frame is redrawn before they are mapped, so a
+job that converts the live framebuffer instead of its snapshot is caught. It runs once with the render
+thread of EXT_OLC_ASYNC and once without.
+
+Prints the mismatches and returns non-zero if there are any. Run it under the sanitizers too:
+
+	g++ -std=c++14 -O1 -g -fsanitize=address,undefined -I../ConsoleGL -I../glm PackBufferReadback.cpp ../ConsoleGL/GL.cpp -lpthread
+	g++ -std=c++14 -O1 -g -fsanitize=thread -I../ConsoleGL -I../glm PackBufferReadback.cpp ../ConsoleGL/GL.cpp -lpthread
+*/
+
+#include "Scene.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define WIDTH 100
+#define HEIGHT 70
+#define IN_FLIGHT 3
+
+struct ReadFormat {
+	int format;
+	int type;
+	int pixelSize;
+};
+
+int main() {
+	static const int colorFormats[] = { GL_RGBA32F, GL_RGBA8, GL_RGB565, EXT_OLC_PIXEL_FORMAT };
+	static const ReadFormat readFormats[] = {
+		{ GL_RGBA, GL_BYTE, 4 },
+		{ GL_RGB, GL_FLOAT, 12 },
+		{ GL_RGBA, GL_FLOAT, 16 },
+		{ GL_DEPTH_COMPONENT, GL_FLOAT, 4 },
+	};
+
+	int mismatches = 0;
+	srand(5);
+
+	for (int async = 0; async < 2; async++) {
+		glInit(WIDTH, HEIGHT);
+		setupScene();
+		if (async) glEnable(EXT_OLC_ASYNC);
+
+		int buffers[IN_FLIGHT];
+		glGenBuffers(IN_FLIGHT, buffers);
+
+		for (int c = 0; c < sizeof(colorFormats) / sizeof(colorFormats[0]); c++) {
+			glFramebufferFormatEXT(colorFormats[c], GL_DEPTH_COMPONENT16);
+
+			for (int r = 0; r < sizeof(readFormats) / sizeof(readFormats[0]); r++) {
+				const ReadFormat& read = readFormats[r];
+				int x = rand() % 30 - 5;
+				int y = rand() % 30 - 5;
+				int w = rand() % 60 + 1;
+				int h = rand() % 50 + 1;
+				int offset = 64;
+				size_t size = offset + (w * read.pixelSize + 3) / 4 * 4 * h;
+
+				std::vector<std::vector<unsigned char> > expected(IN_FLIGHT, std::vector<unsigned char>(size, 0));
+				for (int i = 0; i < IN_FLIGHT; i++) {
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+					glBufferData(GL_PIXEL_PACK_BUFFER, (int)size, nullptr, GL_STREAM_READ);
+					memset(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY), 0, size);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+
+				for (int i = 0; i < IN_FLIGHT; i++) {
+					glClearColor(0.1f * i, 0.3f, 0.5f, 1.0f);
+					drawScene(i * 20.0f);
+
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+					glReadPixels(x, y, w, h, read.format, read.type, expected[i].data() + offset);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+					glReadPixels(x, y, w, h, read.format, read.type, (void*)(size_t)offset);
+				}
+
+				// Overwrite the framebuffer while the reads may still be queued
+				drawScene(99.0f);
+
+				for (int i = 0; i < IN_FLIGHT; i++) {
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+					const unsigned char* mapped = (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+					if (mapped == nullptr || memcmp(mapped, expected[i].data(), size) != 0) {
+						printf("async %d, color format %x, read %x %x: buffer %d differs\n", async, colorFormats[c], read.format, read.type, i);
+						mismatches++;
+					}
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+			}
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glDeleteBuffers(IN_FLIGHT, buffers);
+		if (glGetError() != GL_NO_ERROR) {
+			printf("async %d: unexpected GL error\n", async);
+			mismatches++;
+		}
+		glDestroyContextEXT(glGetCurrentContextEXT());
+	}
+
+	printf("%d mismatches\n", mismatches);
+	return mismatches != 0;
+}
@@ -0,0 +1,115 @@
+/*
+Measures the frame time of the engine loop at pipeline depths 0, 1 and 2. Every frame the update stage
+either sleeps or spins for the given microseconds, then draws the cube and the given number of extra
+triangles.
+
+A sleeping update leaves the core free, so the render and present threads can overlap with it even on a
+single core. A spinning update does a fixed amount of work, calibrated to take that long on an idle core,
+and competes with them for the cores, the overlap only pays off with at least as many cores as busy
+stages. The core count is printed first.
+
+The arguments are the update stage (sleep or spin), its length in microseconds, the extra triangles and
+the frames per depth. The console is drawn to stdout and the results go to stderr:
+
+	g++ -std=c++14 -O2 -I../ConsoleGL -I../glm PipelineBench.cpp ../ConsoleGL/GL.cpp -lpthread
+	./a.out sleep 4000 200 200 > /dev/null
+	./a.out spin 4000 200 200 > /dev/null
+*/
+
+#include "Scene.h"
+#include <olcConsoleGameEngine.h>
+#include <cstdlib>
+#include <cstring>
+
+#define WIDTH 160
+#define HEIGHT 100
+
+bool spin = false;
+int updateTime = 0;
+// Iterations of work() that take updateTime on an idle core
+long long spinIterations = 0;
+int triangles = 0;
+int frames = 100;
+
+volatile unsigned int sink;
+
+void work(long long iterations) {
+	unsigned int x = 1;
+	for (long long i = 0; i < iterations; i++) {
+		x = x * 1664525u + 1013904223u;
+	}
+	sink = x;
+}
+
+// Spinning until a point in time would take less work whenever another stage gets the core
+void calibrate() {
+	long long iterations = 1 << 16;
+	while (true) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		work(iterations);
+		double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		if (us > 20000) {
+			spinIterations = (long long)(iterations * updateTime / us);
+			return;
+		}
+		iterations *= 2;
+	}
+}
+
+class BenchEngine : public olcConsoleGameEngine {
+	int frame = 0;
+
+	virtual bool OnUserCreate() {
+		glFramebufferFormatEXT(EXT_OLC_PIXEL_FORMAT, GL_DEPTH_COMPONENT16);
+		setupScene();
+		return true;
+	}
+
+	virtual bool OnUserUpdate(float fElapsedTime) {
+		if (spin)
+			work(spinIterations);
+		else
+			this_thread::sleep_for(chrono::microseconds(updateTime));
+
+		drawScene(frame * 3.0f);
+		glBegin(GL_TRIANGLES);
+		for (int i = 0; i < triangles; i++) {
+			glColor3f(1, 0, 0);
+			glVertex3f(0, 0, 0);
+			glVertex3f(1, 0, 1);
+			glVertex3f(1, 1, 1);
+		}
+		glEnd();
+
+		return ++frame < frames;
+	}
+};
+
+int main(int argc, char** argv) {
+	if (argc != 5 || (strcmp(argv[1], "sleep") != 0 && strcmp(argv[1], "spin") != 0)) {
+		fprintf(stderr, "usage: %s sleep|spin update_us triangles frames\n", argv[0]);
+		return 1;
+	}
+	spin = strcmp(argv[1], "spin") == 0;
+	updateTime = atoi(argv[2]);
+	triangles = atoi(argv[3]);
+	frames = atoi(argv[4]);
+	if (spin)
+		calibrate();
+
+	fprintf(stderr, "%u hardware threads, %s update of %d us, %d extra triangles\n", thread::hardware_concurrency(), argv[1], updateTime, triangles);
+
+	for (int depth = 0; depth <= 2; depth++) {
+		BenchEngine engine;
+		if (!engine.ConstructConsole(WIDTH, HEIGHT, 4, 4))
+			return 1;
+		engine.SetPipelineDepth(depth);
+		engine.SetTargetFps(0);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		engine.Start();
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		fprintf(stderr, "depth %d: %.2f ms per frame\n", depth, ms / frames);
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+Scenes shared by the test programs in this directory. They are untextured so the programs run from
+any working directory.
+*/
+
+#pragma once
+
+#include <GL.h>
+#include <vector>
+#include <cstddef>
+
+// Depth testing and a projection the cube of drawScene fills
+inline void setupScene() {
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClearDepth(1.0f);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glPerspective(1.0f, 1.0f, 1, 5);
+}
+
+// A cube turned by t degrees around its vertical axis
+inline void drawScene(float t) {
+	static const float faces[6][4][3] = {
+		{ { 0, 1, 1 }, { 1, 1, 1 }, { 1, 0, 1 }, { 0, 0, 1 } },
+		{ { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 } },
+		{ { 0, 0, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 0, 0, 0 } },
+		{ { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 0, 0, 0 } },
+		{ { 1, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, { 1, 0, 0 } },
+	};
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glLookAt(2, 2, 2, 0, 0, 0, 0, 0, 1);
+	glRotatef(t, 0, 0, 1);
+	glTranslatef(-0.5f, -0.5f, -0.2f);
+
+	glBegin(GL_QUADS);
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 4; j++) {
+			const float* v = faces[i][j];
+			glColor3f(v[0], v[1], 0.25f + 0.125f * i);
+			glVertex3f(v[0], v[1], v[2]);
+		}
+	}
+	glEnd();
+}
+
+// count small triangles in rows over the whole framebuffer, a frame of many commands. Leaves both
+// matrices at identity, call setupScene before drawScene again.
+inline void drawGrid(int count, float t) {
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+
+	int rows = (count + 59) / 60;
+	glBegin(GL_TRIANGLES);
+	for (int i = 0; i < count; i++) {
+		float x = -1 + (i % 60) / 30.0f;
+		float y = -1 + (i / 60) * 2.0f / rows;
+		glColor3f((i % 7) / 7.0f, (i % 5) / 5.0f, t);
+		glVertex3f(x, y, 0.5f);
+		glVertex3f(x + 0.05f, y, 0.5f);
+		glVertex3f(x, y + 0.06f, 0.5f);
+	}
+	glEnd();
+}
+
+// FNV-1a of the color buffer read as GL_RGBA GL_BYTE
+inline unsigned long long hashFrame(int w, int h) {
+	std::vector<unsigned char> pixels(w * h * 4);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_BYTE, pixels.data());
+
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < pixels.size(); i++) {
+		hash ^= pixels[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
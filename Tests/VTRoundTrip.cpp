@@ -0,0 +1,214 @@
+/*
+Feeds what VTConsole sends for each frame to a small VT emulator and checks that the emulated screen
+holds exactly the cells that were presented. The frames are a turning cube read back with
+glReadCellsEXT and dirty tiles, so most of them only send a few runs of cells, with a title change and
+a forced redraw in between.
+
+The emulator knows the subset of VT100/xterm the VT_CELLS mode uses: CUP, CUF, SGR with the 16 colors,
+CR LF, OSC titles, the private modes of Begin() and End(), UTF-8 and the pending wrap of the last column.
+Anything else is reported as an unknown sequence.
+
+Prints the bytes per frame and the mismatches, returns non-zero if there are any. Needs POSIX, the
+output goes to a temporary file:
+
+	g++ -std=c++14 -O1 -g -I../ConsoleGL -I../glm VTRoundTrip.cpp ../ConsoleGL/GL.cpp -lpthread
+*/
+
+#include "Scene.h"
+#include <VTConsole.h>
+#include <cstdio>
+#include <unistd.h>
+
+#define WIDTH 160
+#define HEIGHT 100
+#define FRAMES 60
+
+struct Emulator {
+	unsigned int ch[HEIGHT][WIDTH];
+	int attr[HEIGHT][WIDTH];
+	int x, y;
+	int pen;
+	bool wrap;
+	int unknown;
+
+	Emulator()
+		:	x(0),
+			y(0),
+			pen(0x07),
+			wrap(false),
+			unknown(0)
+	{
+		for (int i = 0; i < HEIGHT; i++) {
+			for (int j = 0; j < WIDTH; j++) {
+				ch[i][j] = ' ';
+				attr[i][j] = 0x07;
+			}
+		}
+	}
+
+	// SGR colors are RGB, console colors BGR
+	static int color(int sgr) {
+		return ((sgr & 1) << 2) | (sgr & 2) | ((sgr & 4) >> 2);
+	}
+
+	void sgr(int param) {
+		if (param <= 0) pen = 0x07;
+		else if (param >= 30 && param < 38) pen = (pen & 0xF0) | color(param - 30);
+		else if (param >= 90 && param < 98) pen = (pen & 0xF0) | color(param - 90) | 8;
+		else if (param >= 40 && param < 48) pen = (pen & 0x0F) | (color(param - 40) << 4);
+		else if (param >= 100 && param < 108) pen = (pen & 0x0F) | ((color(param - 100) | 8) << 4);
+		else unknown++;
+	}
+
+	// Returns the index after the sequence starting at s[i] == ESC
+	size_t escape(const std::vector<char>& s, size_t i) {
+		i++;
+		if (s[i] == ']') {
+			while (s[i] != '\x07') i++;
+			return i + 1;
+		}
+		if (s[i] != '[') {
+			unknown++;
+			return i + 1;
+		}
+		i++;
+
+		bool question = s[i] == '?';
+		if (question) i++;
+
+		std::vector<int> params;
+		int param = -1;
+		for (;; i++) {
+			char c = s[i];
+			if (c >= '0' && c <= '9') {
+				param = (param < 0 ? 0 : param * 10) + (c - '0');
+				continue;
+			}
+			params.push_back(param);
+			param = -1;
+			if (c == ';') continue;
+
+			if (question) {
+				if (c != 'h' && c != 'l') unknown++;
+			}
+			else if (c == 'H') {
+				y = (params[0] < 1 ? 1 : params[0]) - 1;
+				x = (params.size() > 1 && params[1] > 0 ? params[1] : 1) - 1;
+				wrap = false;
+			}
+			else if (c == 'C') {
+				x += params[0] < 1 ? 1 : params[0];
+				wrap = false;
+			}
+			else if (c == 'm') {
+				for (size_t p = 0; p < params.size(); p++) sgr(params[p]);
+			}
+			else if (c != 'J') {
+				unknown++;
+			}
+			return i + 1;
+		}
+	}
+
+	void feed(const std::vector<char>& s) {
+		size_t i = 0;
+		while (i < s.size()) {
+			unsigned char c = s[i];
+			if (c == 0x1B) {
+				i = escape(s, i);
+				continue;
+			}
+			if (c == '\r') {
+				x = 0;
+				wrap = false;
+				i++;
+				continue;
+			}
+			if (c == '\n') {
+				y++;
+				i++;
+				continue;
+			}
+
+			unsigned int code;
+			int length;
+			if (c < 0x80) { code = c; length = 1; }
+			else if (c < 0xE0) { code = c & 0x1F; length = 2; }
+			else if (c < 0xF0) { code = c & 0x0F; length = 3; }
+			else { code = c & 0x07; length = 4; }
+			for (int k = 1; k < length; k++) code = (code << 6) | (s[i + k] & 0x3F);
+			i += length;
+
+			if (wrap) {
+				x = 0;
+				y++;
+				wrap = false;
+			}
+			if (x >= WIDTH || y >= HEIGHT) {
+				unknown++;
+				continue;
+			}
+			ch[y][x] = code;
+			attr[y][x] = pen;
+			if (x == WIDTH - 1) wrap = true;
+			else x++;
+		}
+	}
+};
+
+int main() {
+	FILE* file = tmpfile();
+	if (file == nullptr) {
+		printf("can not create the output file\n");
+		return 1;
+	}
+
+	glInit(WIDTH, HEIGHT);
+	glFramebufferFormatEXT(EXT_OLC_PIXEL_FORMAT, GL_DEPTH_COMPONENT16);
+	glEnable(EXT_OLC_DIRTY_TILES);
+	setupScene();
+
+	Emulator emulator;
+	VTConsole vt(fileno(file));
+	vt.Resize(WIDTH, HEIGHT);
+	vt.Begin();
+
+	off_t position = lseek(fileno(file), 0, SEEK_CUR);
+	size_t total = 0;
+	int mismatches = 0;
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		drawScene(frame * 0.5f);
+		if (frame == FRAMES / 2) vt.SetTitle(L"Round trip █");
+		if (frame == FRAMES / 2 + 10) vt.Invalidate();
+
+		OlcCellLayoutEXT layout = vt.Layout();
+		glReadCellsEXT(0, 0, WIDTH, HEIGHT, &layout);
+		VTFrameStats stats = vt.Present();
+
+		std::vector<char> sent(stats.bytes);
+		if (pread(fileno(file), sent.data(), sent.size(), position) != (ssize_t)sent.size()) {
+			printf("frame %d: short read\n", frame);
+			return 1;
+		}
+		position += stats.bytes;
+		total += stats.bytes;
+		emulator.feed(sent);
+
+		int wrong = 0;
+		for (int y = 0; y < HEIGHT; y++) {
+			for (int x = 0; x < WIDTH; x++) {
+				const VTCell& cell = vt.Cells()[y * WIDTH + x];
+				if (emulator.ch[y][x] != cell.ch || emulator.attr[y][x] != (cell.attr & 0xFF)) wrong++;
+			}
+		}
+		if (wrong) printf("frame %d: %d cells differ\n", frame, wrong);
+		mismatches += wrong;
+	}
+
+	vt.End();
+	fclose(file);
+
+	printf("%zu bytes per frame, %d unknown sequences, %d mismatches\n", total / FRAMES, emulator.unknown, mismatches);
+	return mismatches != 0 || emulator.unknown != 0 || glGetError() != GL_NO_ERROR;
+}